@@ -0,0 +1,278 @@
+#include "analysis.h"
+#include "program.h"
+#include <string.h>
+#include <assert.h>
+
+/* Load-time stack analysis.
+ *
+ * The state at a program point bounds the GOSUB and FOR stacks any run can have
+ * there; the FOR depth is also kept relative to the entry of the current
+ * subroutine. States are kept for line starts and propagated along the lines
+ * (fall through, IF skipping to the next line, GOTO/THEN, GOSUB into the callee)
+ * until they stop growing. Jumps that do not land on a line start are folded
+ * into global states:
+ * - NEXT V jumps back after a FOR V, with the FOR stack cut back to that frame:
+ *   the FOR depth is the one the FOR itself produced, the GOSUB depth is the
+ *   NEXT's (it may run in a subroutine). Each FOR V joins the NEXT V states.
+ * - RETURN resumes after a GOSUB at the caller's GOSUB depth, with the FOR
+ *   frames the callee left: every GOSUB adds the deepest relative FOR depth of
+ *   all RETURNs.
+ * Depths are capped one above the stack sizes: reaching the cap means recursion
+ * or nesting too deep to prove, and the VM keeps checking that stack.
+ * A computed GOTO/GOSUB/THEN target makes the flow unknown: nothing is proven. */
+
+enum
+{
+    ANALYSIS_SWEEPS_MAX = 256, /* Give up (nothing proven) if the states still grow */
+    TARGET_COMPUTED = -2       /* analysis_target(): not a literal line number or label */
+};
+
+typedef struct
+{
+    int call; /* GOSUB stack depth */
+    int loop; /* FOR stack depth */
+    int rel;  /* FOR stack depth relative to the subroutine entry (<= loop) */
+} StackDepth;
+
+/* State at each line start (position in the line index) */
+static StackDepth line_depth[LINES_EXT_MAX];
+static bool line_reached[LINES_EXT_MAX];
+
+static StackDepth next_depth[27]; /* Joined at every NEXT V (0: NEXT alone), resumed after FOR V */
+static int return_rel;            /* Relative FOR depth joined at every RETURN, added after every GOSUB */
+static StackDepth max_depth;      /* Deepest state seen */
+static int max_nesting;           /* Deepest expression nesting seen */
+static bool changed;              /* A state grew during this sweep */
+static bool flow_unknown;         /* A computed jump was found */
+
+/* Cap a state one above the stack sizes, and record the deepest one */
+static StackDepth analysis_cap(StackDepth depth)
+{
+    if (depth.call > GOSUB_MAX)
+        depth.call = GOSUB_MAX + 1;
+    if (depth.loop > FOR_MAX)
+        depth.loop = FOR_MAX + 1;
+    if (depth.rel > depth.loop)
+        depth.rel = depth.loop;
+    if (depth.rel < -(FOR_MAX + 1))
+        depth.rel = -(FOR_MAX + 1);
+    if (max_depth.call < depth.call)
+        max_depth.call = depth.call;
+    if (max_depth.loop < depth.loop)
+        max_depth.loop = depth.loop;
+    return depth;
+}
+
+/* Join a state into another, noting growth */
+static void analysis_join(StackDepth *into, StackDepth depth)
+{
+    if (into->call < depth.call)
+    {
+        into->call = depth.call;
+        changed = true;
+    }
+    if (into->loop < depth.loop)
+    {
+        into->loop = depth.loop;
+        changed = true;
+    }
+    if (into->rel < depth.rel)
+    {
+        into->rel = depth.rel;
+        changed = true;
+    }
+}
+
+/* Loop variable after FOR/NEXT, 0 for a NEXT alone */
+static int analysis_loop_var(uint8_t *pos)
+{
+    return pos[1] == T_VAR ? pos[2] : 0;
+}
+
+/* Continue at a line start with a state */
+static void analysis_reach(int index, StackDepth depth)
+{
+    assert(0 <= index && index < g_program.lines_len);
+    depth = analysis_cap(depth);
+    if (!line_reached[index])
+    {
+        line_reached[index] = true;
+        line_depth[index] = depth;
+        changed = true;
+        return;
+    }
+    analysis_join(&line_depth[index], depth);
+}
+
+/* Line a GOTO/GOSUB/THEN target goes to: its position, -1 if there is no such
+ * line (an error at run time), or TARGET_COMPUTED. *after is the token after a literal */
+static int analysis_target(uint8_t *target, uint8_t **after)
+{
+    if (!token_is_num(*target) && *target != T_STR)
+        return TARGET_COMPUTED;
+
+    *after = token_skip(target);
+    if (**after != T_COLON && **after != T_EOL)
+        return TARGET_COMPUTED;
+
+    if (*target == T_STR)
+    {
+        uint8_t *line_ptr = program_find_line_label(str_word_make((const char *)target + 2, target[1]));
+        return line_ptr ? program_index_of(get_line(line_ptr)) : -1;
+    }
+
+    double line_num = token_num_value(target);
+    if (!(1 <= line_num && line_num < (double)g_program.line_num_max + 1))
+        return -1;
+    return program_index_of((uint32_t)line_num);
+}
+
+/* Follow one line from its start, propagating its state to where execution can continue */
+static void analysis_scan_line(int index)
+{
+    StackDepth depth = line_depth[index];
+    int nesting = 0;
+    bool has_next_line = index + 1 < g_program.lines_len;
+
+    for (uint8_t *pos = get_tokens(program_line_at(index));;)
+    {
+        uint8_t token = *pos;
+        switch (token)
+        {
+        case T_EOL:
+        case T_REM: /* The comment runs to the end of the line */
+            if (has_next_line)
+                analysis_reach(index + 1, depth);
+            return;
+
+        case T_IF: /* A false condition skips to the next line */
+            if (has_next_line)
+                analysis_reach(index + 1, depth);
+            pos++;
+            break;
+
+        case T_GOTO:
+        case T_THEN:
+        case T_GOSUB:
+        {
+            uint8_t *after;
+            int target = analysis_target(pos + 1, &after);
+            if (target == TARGET_COMPUTED)
+            {
+                flow_unknown = true;
+                return;
+            }
+            if (token != T_GOSUB)
+            {
+                if (target >= 0)
+                    analysis_reach(target, depth);
+                return;
+            }
+            if (target >= 0)
+                analysis_reach(target, (StackDepth){depth.call + 1, depth.loop, 0});
+            if (return_rel > 0)
+            {
+                depth.loop += return_rel;
+                depth.rel += return_rel;
+                depth = analysis_cap(depth);
+            }
+            pos = after;
+            break;
+        }
+
+        case T_RETURN:
+            if (return_rel < depth.rel)
+            {
+                return_rel = depth.rel;
+                changed = true;
+            }
+            return;
+
+        case T_END:
+        case T_STOP:
+            return;
+
+        case T_FOR:
+        {
+            /* Body: entered from the FOR, or looping back from a NEXT */
+            StackDepth body = {depth.call, depth.loop + 1, depth.rel + 1};
+            int var = analysis_loop_var(pos);
+            for (int i = 0; i < 2; i++)
+            {
+                StackDepth next = next_depth[i == 0 ? 0 : var];
+                if (body.call < next.call)
+                    body.call = next.call;
+                if (body.rel < next.rel)
+                    body.rel = next.rel;
+            }
+            depth = analysis_cap(body);
+            pos++;
+            break;
+        }
+
+        case T_NEXT: /* Loops back after a FOR, or leaves at least one frame */
+            analysis_join(&next_depth[analysis_loop_var(pos)], depth);
+            if (depth.loop > 0)
+                depth.loop--;
+            depth.rel--;
+            depth = analysis_cap(depth);
+            pos++;
+            break;
+
+        case T_LP:
+        case T_VIDX:
+        case T_SVIDX:
+            nesting++;
+            if (max_nesting < nesting)
+                max_nesting = nesting;
+            pos++;
+            break;
+
+        case T_RP:
+        case T_ENDX:
+            nesting--;
+            pos++;
+            break;
+
+        default:
+            pos = token_skip(pos);
+            break;
+        }
+    }
+}
+
+/* Prove stack bounds for the loaded program */
+void analyze_program(void)
+{
+    int lines_len = g_program.lines_len;
+
+    memset(line_reached, 0, lines_len * sizeof(line_reached[0]));
+    memset(next_depth, 0, sizeof(next_depth));
+    return_rel = 0;
+    max_depth = (StackDepth){0, 0, 0};
+    max_nesting = 0;
+    changed = false;
+    flow_unknown = false;
+
+    if (lines_len > 0)
+        analysis_reach(0, (StackDepth){0, 0, 0});
+
+    for (int sweep = 0; changed && !flow_unknown && sweep < ANALYSIS_SWEEPS_MAX; sweep++)
+    {
+        changed = false;
+        for (int index = 0; index < lines_len; index++)
+        {
+            if (line_reached[index])
+                analysis_scan_line(index);
+        }
+    }
+
+    program_set_unanalyzed();
+    g_program.expr_depth = max_nesting;
+    if (flow_unknown || changed)
+        return;
+    if (max_depth.call <= GOSUB_MAX)
+        g_program.call_depth = max_depth.call;
+    if (max_depth.loop <= FOR_MAX)
+        g_program.for_depth = max_depth.loop;
+}
@@ -0,0 +1,8 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+/* Load-time stack analysis: proves GOSUB and FOR depth bounds for the loaded
+ * program (g_program.call_depth, for_depth, expr_depth) */
+void analyze_program(void);
+
+#endif /* ANALYSIS_H */
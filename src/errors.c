@@ -34,6 +34,8 @@ const char *error_message(ErrorCode code)
         return "RETURN without GOSUB";
     case ERR_NEXT_WITHOUT_FOR:
         return "NEXT without FOR";
+    case ERR_INPUT_END:
+        return "End of input";
 
     /* Type 2 errors (structural) */
     case ERR_BAD_LINE_NUMBER:
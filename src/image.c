@@ -0,0 +1,216 @@
+#include "image.h"
+#include "program.h"
+#include "listing.h"
+#include "output.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char image_magic[4] = {'P', 'C', 'B', '1'};
+
+/* Checksum: 64 bit FNV-1a taken a word at a time, the high half folded back
+ * in at each step so every bit reaches the result */
+static const uint64_t image_hash_basis = 0xCBF29CE484222325ull;
+static const uint64_t image_hash_prime = 0x100000001B3ull;
+
+static uint64_t image_hash(uint64_t hash, const void *bytes, size_t len)
+{
+    const uint8_t *pos = bytes;
+    for (; len >= sizeof(uint64_t); pos += sizeof(uint64_t), len -= sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, pos, sizeof(word));
+        hash = (hash ^ word) * image_hash_prime;
+        hash ^= hash >> 32;
+    }
+    for (; len > 0; pos++, len--)
+        hash = (hash ^ *pos) * image_hash_prime;
+    return hash;
+}
+
+/* Section sizes in bytes */
+static size_t image_consts_size(const ImageHeader *header) { return header->consts_len * sizeof(double); }
+static size_t image_index_size(const ImageHeader *header) { return (header->lines_len + 1) * sizeof(uint32_t); }
+
+/* Checksum of a header and its sections */
+static uint64_t image_checksum(const ImageHeader *header, const void *consts, const void *line_index, const void *prog)
+{
+    ImageHeader unsummed = *header;
+    unsummed.checksum = 0;
+    uint64_t hash = image_hash(image_hash_basis, &unsummed, sizeof(unsummed));
+    hash = image_hash(hash, consts, image_consts_size(header));
+    hash = image_hash(hash, line_index, image_index_size(header));
+    return image_hash(hash, prog, header->prog_len);
+}
+
+bool image_save(const char *filename)
+{
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, image_magic, sizeof(header.magic));
+    header.byte_order = IMAGE_BYTE_ORDER;
+    header.version = IMAGE_VERSION;
+    header.prog_len = (uint32_t)g_program.prog_len;
+    header.lines_len = (uint32_t)g_program.lines_len;
+    header.consts_len = (uint32_t)g_program.consts_len;
+    header.checksum = image_checksum(&header, g_program.consts, g_program.line_index, g_program.prog);
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool written = fd_write_all(fd, (const char *)&header, sizeof(header)) &&
+                   fd_write_all(fd, (const char *)g_program.consts, (uint32_t)image_consts_size(&header)) &&
+                   fd_write_all(fd, (const char *)g_program.line_index, (uint32_t)image_index_size(&header)) &&
+                   fd_write_all(fd, (const char *)g_program.prog, header.prog_len);
+    return close(fd) == 0 && written;
+}
+
+/* What is wrong with the header of a mapped image of size bytes, NULL if nothing */
+static const char *image_check_header(const ImageHeader *header, size_t size)
+{
+    if (size < sizeof(*header) || memcmp(header->magic, image_magic, sizeof(header->magic)) != 0)
+        return "not a program image";
+    if (header->byte_order != IMAGE_BYTE_ORDER)
+        return "saved on a host of the other byte order";
+    if (header->version != IMAGE_VERSION)
+        return "saved by another version of the interpreter";
+    if (header->prog_len < 2 || header->prog_len > PROG_EXT_MAX_BYTES ||
+        header->lines_len > (uint32_t)g_program.lines_max || header->consts_len > (uint32_t)g_program.consts_max)
+        return "too large for the memory limits in force (try --extended)";
+    if (size != sizeof(*header) + image_consts_size(header) + image_index_size(header) + header->prog_len)
+        return "truncated";
+    return NULL;
+}
+
+/* What is wrong with the tokens of a restored line, NULL if nothing: each one
+ * known with its operands inside the line, constants in the pool,
+ * variables A..Z and strings without a NUL (the tokenizer never emits one),
+ * as the VM takes them without checking */
+static const char *image_check_tokens(uint8_t *line_ptr)
+{
+    const uint8_t *end = line_ptr + get_len(line_ptr) - 1; /* The final T_EOL */
+    for (const uint8_t *pos = get_tokens(line_ptr); pos < end;)
+    {
+        int len = 1;
+        uint32_t operand = 0;
+        switch (*pos)
+        {
+        case T_NUM:
+        case T_INT8:
+        case T_VAR:
+        case T_SVAR:
+            len = 2;
+            operand = pos + 1 < end ? pos[1] : 0;
+            break;
+        case T_NUM16:
+        case T_INT16:
+            len = 3;
+            operand = pos + 2 < end ? get_u16(pos + 1) : 0;
+            break;
+        case T_STR:
+            len = pos + 1 < end ? 2 + pos[1] : 2;
+            break;
+        default:
+            if (*pos == T_EOL || !token_is_known(*pos))
+                return "unknown token";
+            break;
+        }
+        if (len > end - pos)
+            return "token runs past its line";
+        if (*pos == T_STR && memchr(pos + 2, '\0', (size_t)(len - 2)))
+            return "NUL inside a string";
+        if ((*pos == T_NUM || *pos == T_NUM16) && operand >= (uint32_t)g_program.consts_len)
+            return "constant outside the pool";
+        if ((*pos == T_VAR || *pos == T_SVAR) && (operand < 1 || operand > 26))
+            return "variable out of range";
+        pos += len;
+    }
+    return NULL;
+}
+
+/* What is wrong with the restored line records, NULL if nothing: each one
+ * where the index says, ending with T_EOL, in increasing line order, with
+ * well formed tokens */
+static const char *image_check_records(void)
+{
+    uint32_t offset = 0;
+    uint32_t line_num = 0;
+    for (int index = 0; index < g_program.lines_len; index++)
+    {
+        if (g_program.line_index[index] != offset || offset + LINE_HDR_LEN + 1 > (uint32_t)g_program.prog_len - 2)
+            return "line index out of step with the records";
+        uint8_t *line_ptr = program_line_at(index);
+        if (get_len(line_ptr) < LINE_HDR_LEN + 1 || offset + get_len(line_ptr) > (uint32_t)g_program.prog_len - 2 ||
+            line_ptr[get_len(line_ptr) - 1] != T_EOL)
+            return "malformed line record";
+        if (get_line(line_ptr) <= line_num || get_line(line_ptr) > g_program.line_num_max)
+            return "line numbers out of order or range";
+        const char *problem = image_check_tokens(line_ptr);
+        if (problem)
+            return problem;
+        line_num = get_line(line_ptr);
+        offset += get_len(line_ptr);
+    }
+    if (g_program.line_index[g_program.lines_len] != offset || offset + 2 != (uint32_t)g_program.prog_len ||
+        get_len(program_line_at(g_program.lines_len)) != 0)
+        return "missing program terminator";
+    return NULL;
+}
+
+/* Map the image in one piece, check it, and copy its sections into place */
+bool image_load(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot open image: %s\n", filename);
+        return false;
+    }
+    struct stat st;
+    const uint8_t *map = MAP_FAILED;
+    size_t size = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        size = (size_t)st.st_size;
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Invalid image %s: not a program image\n", filename);
+        return false;
+    }
+
+    ImageHeader header;
+    memcpy(&header, map, size < sizeof(header) ? size : sizeof(header));
+    const char *problem = image_check_header(&header, size);
+
+    const uint8_t *consts = map + sizeof(header);
+    const uint8_t *line_index = consts + image_consts_size(&header);
+    const uint8_t *prog = line_index + image_index_size(&header);
+    if (!problem && image_checksum(&header, consts, line_index, prog) != header.checksum)
+        problem = "checksum mismatch";
+    if (!problem)
+    {
+        /* The header is 8 byte aligned and the sections follow in decreasing alignment */
+        program_restore(prog, (int)header.prog_len, (const uint32_t *)line_index, (int)header.lines_len,
+                        (const double *)consts, (int)header.consts_len);
+        problem = image_check_records();
+        if (!problem && program_size() > g_program.prog_max)
+            problem = "too large for the memory limits in force (try --extended)";
+    }
+    munmap((void *)map, size);
+
+    if (problem)
+    {
+        program_clear();
+        fprintf(stderr, "Invalid image %s: %s\n", filename, problem);
+        return false;
+    }
+    printf("Loaded %d lines\n", g_program.lines_len);
+    return true;
+}
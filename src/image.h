@@ -0,0 +1,43 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Program images (.pcb): the tokenized program saved as it sits in memory,
+ * so that a later run maps it back instead of tokenizing the source again.
+ *
+ * Layout (host byte order, recorded in the header):
+ *   ImageHeader
+ *   double consts[consts_len]            constant pool
+ *   uint32_t line_index[lines_len + 1]   record offsets, then the terminator's
+ *   uint8_t prog[prog_len]               line records and terminator
+ * The checksum covers the header (with a zero checksum) and all three
+ * sections. Labels are the T_STR at the start of their line: they come with
+ * the records. The load-time stack analysis is not saved: its bounds switch
+ * off the VM's stack checks, so it is run again on the loaded records. */
+
+enum
+{
+    IMAGE_VERSION = 2,              /* Bumped whenever the token format changes */
+    IMAGE_BYTE_ORDER = 0x01020304u  /* Reads back differently on a host of the other order */
+};
+
+typedef struct
+{
+    char magic[4];       /* "PCB1" */
+    uint32_t byte_order; /* IMAGE_BYTE_ORDER */
+    uint32_t version;    /* IMAGE_VERSION */
+    uint32_t prog_len;
+    uint32_t lines_len;
+    uint32_t consts_len;
+    uint64_t checksum;
+} ImageHeader;
+
+/* Save the loaded program, false if the file cannot be written */
+bool image_save(const char *filename);
+
+/* Replace the program with an image, false on an error (reported) */
+bool image_load(const char *filename);
+
+#endif /* IMAGE_H */
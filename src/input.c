@@ -0,0 +1,287 @@
+#include "input.h"
+#include "output.h"
+#include "ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+static const char *deck;     /* Next record of the scripted input, NULL: stdin */
+static const char *deck_end;
+static char deck_separator;  /* Separates records besides newlines */
+static InputEofPolicy eof_policy;
+static char stdin_line[INPUT_LINE_MAX];
+
+/* Read-ahead mode: stdin lines, as fgets() would split them */
+typedef struct
+{
+    uint32_t len; /* Without the newline */
+    char text[INPUT_LINE_MAX];
+} InputRecord;
+
+static bool reader_mode;
+static InputRecord input_ring[INPUT_RING_RECORDS];
+static RingSync input_sync;
+static char reader_chunk[65536];
+static pthread_t reader_thread;
+
+void input_init(void)
+{
+    deck = NULL;
+    eof_policy = INPUT_EOF_KEEP;
+}
+
+bool input_open_file(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    size_t size = 0;
+    const char *map = ""; /* An empty file has no mapping */
+    if (fstat(fd, &st) != 0)
+        map = MAP_FAILED;
+    else if (st.st_size > 0)
+    {
+        size = (size_t)st.st_size;
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    deck = map;
+    deck_end = map + size;
+    deck_separator = '\n';
+    return true;
+}
+
+void input_set_inline(const char *text)
+{
+    deck = text;
+    deck_end = text + strlen(text);
+    deck_separator = ',';
+}
+
+bool input_is_interactive(void)
+{
+    return deck == NULL;
+}
+
+/* Reader thread: fill records from stdin until it ends, publishing them a
+ * whole read() at a time so the VM is not woken for each line */
+static void *input_reader(void *unused)
+{
+    (void)unused;
+    uint32_t filled = 0; /* Complete records not yet published */
+    InputRecord *record = NULL;
+    for (;;)
+    {
+        ssize_t chunk_len = read(STDIN_FILENO, reader_chunk, sizeof(reader_chunk));
+        if (chunk_len <= 0)
+            break;
+
+        for (ssize_t i = 0; i < chunk_len; i++)
+        {
+            if (!record)
+            {
+                if (filled == ring_room(&input_sync))
+                {
+                    ring_publish(&input_sync, filled);
+                    filled = 0;
+                    ring_wait_room(&input_sync, INPUT_RING_RECORDS / 2);
+                }
+                record = &input_ring[(input_sync.head + filled) & (INPUT_RING_RECORDS - 1)];
+                record->len = 0;
+            }
+
+            char c = reader_chunk[i];
+            if (c != '\n')
+                record->text[record->len++] = c;
+            /* A line too long for fgets() is split the same way */
+            if (c == '\n' || record->len == INPUT_LINE_MAX - 1)
+            {
+                filled++;
+                record = NULL;
+            }
+        }
+        ring_publish(&input_sync, filled);
+        filled = 0;
+    }
+
+    if (record) /* Last line without a newline */
+        ring_publish(&input_sync, 1);
+    ring_close(&input_sync);
+    return NULL;
+}
+
+bool input_start_reader(void)
+{
+    assert(!reader_mode);
+    if (!ring_init(&input_sync, INPUT_RING_RECORDS))
+        return false;
+    if (pthread_create(&reader_thread, NULL, input_reader, NULL) != 0)
+        return false;
+    pthread_detach(reader_thread);
+    reader_mode = true;
+    return true;
+}
+
+void input_set_eof_policy(InputEofPolicy policy)
+{
+    eof_policy = policy;
+}
+
+InputEofPolicy input_eof_policy(void)
+{
+    return eof_policy;
+}
+
+bool input_next_record(const char **text, uint32_t *len)
+{
+    const char *start;
+    const char *end;
+
+    if (deck)
+    {
+        if (deck == deck_end)
+            return false;
+        start = deck;
+        for (end = start; end < deck_end && *end != '\n' && *end != deck_separator; end++)
+            ;
+        deck = end < deck_end ? end + 1 : end;
+    }
+    else if (reader_mode)
+    {
+        if (!ring_wait_data(&input_sync))
+            return false;
+        /* Copied out, the slot is free for the reader as soon as it is released */
+        InputRecord *record = &input_ring[input_sync.tail & (INPUT_RING_RECORDS - 1)];
+        memcpy(stdin_line, record->text, record->len);
+        start = stdin_line;
+        end = start + record->len;
+        ring_release(&input_sync, 1);
+    }
+    else
+    {
+        if (!fgets(stdin_line, sizeof(stdin_line), stdin))
+            return false;
+        start = stdin_line;
+        end = start + strlen(stdin_line);
+        if (end > start && end[-1] == '\n')
+            end--;
+    }
+
+    /* As with the strlen() of an fgets() line, the text stops at a NUL */
+    const char *nul = memchr(start, '\0', end - start);
+    if (nul)
+        end = nul;
+    if (end > start && end[-1] == '\r')
+        end--;
+    *text = start;
+    *len = (uint32_t)(end - start);
+    return true;
+}
+
+/* Number parsing */
+
+enum
+{
+    EXACT_DIGITS_MAX = 15, /* Any 15 digit integer is exact in a double */
+    EXACT_EXP_MAX = 22     /* 10^22 is the largest exact power of ten */
+};
+
+double input_parse_num(const char *text, uint32_t len)
+{
+    const char *pos = text;
+    const char *end = text + len;
+
+    while (pos < end && isspace((unsigned char)*pos))
+        pos++;
+    const char *number = pos;
+
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+'))
+        negative = *pos++ == '-';
+
+    /* Mantissa digits, with the decimal exponent they imply */
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp = 0;
+    bool seen_digit = false;
+    for (; pos < end && isdigit((unsigned char)*pos); pos++, seen_digit = true)
+    {
+        if (mantissa == 0 && *pos == '0')
+            continue;
+        if (digits++ < EXACT_DIGITS_MAX)
+            mantissa = mantissa * 10 + (uint64_t)(*pos - '0');
+        else
+            exp++;
+    }
+    if (pos < end && *pos == '.')
+    {
+        for (pos++; pos < end && isdigit((unsigned char)*pos); pos++, seen_digit = true)
+        {
+            if (mantissa == 0 && *pos == '0')
+            {
+                exp--;
+                continue;
+            }
+            if (digits++ < EXACT_DIGITS_MAX)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*pos - '0');
+                exp--;
+            }
+        }
+    }
+    if (!seen_digit)
+        return 0.0;
+
+    /* Exponent, with the display's blank for a positive sign ("1.5E 12") */
+    if (pos + 1 < end && toupper((unsigned char)*pos) == 'E')
+    {
+        const char *exp_pos = pos + 1;
+        bool exp_negative = *exp_pos == '-';
+        if (*exp_pos == '-' || *exp_pos == '+' || *exp_pos == ' ')
+            exp_pos++;
+        if (exp_pos < end && isdigit((unsigned char)*exp_pos))
+        {
+            int exp_value = 0;
+            for (; exp_pos < end && isdigit((unsigned char)*exp_pos); exp_pos++)
+            {
+                if (exp_value < 10000)
+                    exp_value = exp_value * 10 + (*exp_pos - '0');
+            }
+            exp += exp_negative ? -exp_value : exp_value;
+        }
+    }
+
+    if (mantissa == 0)
+        return negative ? -0.0 : 0.0;
+
+    /* Exact mantissa and power of ten: a single, correctly rounded operation */
+    if (digits <= EXACT_DIGITS_MAX && -EXACT_EXP_MAX <= exp && exp <= EXACT_EXP_MAX)
+    {
+        double value = number_scale10((double)mantissa, exp);
+        return negative ? -value : value;
+    }
+
+    /* Long mantissas and large exponents go through the C library */
+    char buffer[INPUT_LINE_MAX];
+    uint32_t number_len = (uint32_t)(end - number);
+    if (number_len >= sizeof(buffer))
+        number_len = sizeof(buffer) - 1;
+    memcpy(buffer, number, number_len);
+    buffer[number_len] = '\0';
+    char *blank = strchr(buffer, ' '); /* strtod() does not know the blank exponent sign */
+    if (blank && blank > buffer && toupper((unsigned char)blank[-1]) == 'E')
+        *blank = '+';
+    return strtod(buffer, NULL);
+}
@@ -0,0 +1,42 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* INPUT reads one record per statement: a line typed on stdin, or the next
+ * entry of a scripted input deck (--input-file, --input-inline). */
+
+enum
+{
+    INPUT_LINE_MAX = 256,    /* stdin line, newline and NUL included */
+    INPUT_RING_RECORDS = 1024 /* Records read ahead by the reader thread, a power of two */
+};
+
+/* What INPUT does once the input is exhausted */
+typedef enum
+{
+    INPUT_EOF_KEEP,  /* The variable keeps its value, the program goes on */
+    INPUT_EOF_END,   /* The program ends, as with END */
+    INPUT_EOF_ERROR  /* ERR_INPUT_END */
+} InputEofPolicy;
+
+/* Source selection (stdin after input_init) */
+void input_init(void);
+bool input_open_file(const char *filename);  /* One record per line */
+void input_set_inline(const char *text);     /* Records separated by ',' or newlines */
+bool input_is_interactive(void);             /* Reading stdin */
+
+/* Read stdin ahead on a thread, split into records, so INPUT only dequeues */
+bool input_start_reader(void);
+
+void input_set_eof_policy(InputEofPolicy policy);
+InputEofPolicy input_eof_policy(void);
+
+/* Next record, without its separator; false once the input is exhausted */
+bool input_next_record(const char **text, uint32_t *len);
+
+/* Number at the start of a record (0 if there is none, like atof) */
+double input_parse_num(const char *text, uint32_t len);
+
+#endif /* INPUT_H */
@@ -0,0 +1,45 @@
+/* Generated by tools/keyword_hash_gen.c from keywords.def - do not edit */
+#ifndef KEYWORD_HASH_H
+#define KEYWORD_HASH_H
+
+#include <stdint.h>
+
+#define KEYWORD_HASH_SEED 7889u
+
+enum
+{
+    KEYWORD_HASH_SIZE = 256,
+    KEYWORD_LEN_MAX = 6 /* Longest spelling */
+};
+
+/* FNV-1a over the case-folded word (letters, digits and '.' only:
+ * c | 0x20 folds the letters and keeps the rest apart) */
+static inline uint32_t keyword_hash(const char *word, int len)
+{
+    uint32_t hash = 2166136261u ^ KEYWORD_HASH_SEED;
+    for (int i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)(word[i] | 0x20)) * 16777619u;
+    return (hash ^ (hash >> 16)) & (KEYWORD_HASH_SIZE - 1);
+}
+
+/* Slot entry: (keyword index * 2 + 1 for the abbreviation) + 1, 0 empty */
+static const uint8_t keyword_slots[KEYWORD_HASH_SIZE] = {
+      0,   0,   0,   0,   0,   0,  23,  40,   0,   0,   0,   0,  31,   0,   0,   6,
+      0,  67,   0,   0,  29,  61,  14,   0,   2,   0,  75,   0,   7,   0,   0,   0,
+     35,   0,   0,   0,   0,  45,  37,   0,  76,   0,  64,   0,   0,  11,  54,  21,
+      0,   0,   0,  44,   0,   0,   0,   0,   0,  22,   0,   0,   0,   0,  72,   0,
+      0,   0,   0,  47,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  58,
+     49,   0,   0,   0,   0,  43,   0,   0,   0,  42,   0,   0,   0,   8,   0,   0,
+      0,   0,   0,  71,  68,   0,  41,   0,   0,   0,   0,   0,   0,  12,   0,   0,
+     59,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     56,   0,   0,   0,   0,   0,  57,   0,  53,   0,   0,   0,   0,  63,   0,   0,
+      0,   0,   0,   0,   0,  10,   0,   0,  33,   0,   0,  55,   0,   0,  36,   0,
+      0,  27,  25,   0,   0,   0,  65,   0,   0,   0,   0,  62,   0,   0,  32,   0,
+      0,   0,  48,  73,   0,   0,   0,   0,   0,   0,  15,   0,   0,   0,   0,   0,
+     70,   0,   0,   0,   0,   0,   0,   0,  39,   0,   0,   0,   0,  51,   0,   5,
+      0,   0,  74,   0,   0,  30,   0,   0,   1,   0,   0,   0,   0,   0,   9,   0,
+      0,  13,   0,   0,   0,   0,   0,   0,  69,   0,   3,  18,   0,   0,   0,   0,
+     19,  34,   0,   0,   0,  17,  28,   0,  46,   0,   0,   0,   0,   0,   0,  52
+};
+
+#endif /* KEYWORD_HASH_H */
@@ -1,9 +1,12 @@
 #include "listing.h"
 #include "program.h"
 #include "errors.h"
+#include "output.h"
 #include <stdio.h>
 #include <assert.h>
 
+static const char token_unknown[] = "UNKNOWN";
+
 /* Token name lookup table */
 const char *token_name(Tok token)
 {
@@ -13,6 +16,12 @@ const char *token_name(Tok token)
         return "EOL";
     case T_NUM:
         return "NUM";
+    case T_NUM16:
+        return "NUM16";
+    case T_INT8:
+        return "INT8";
+    case T_INT16:
+        return "INT16";
     case T_STR:
         return "STR";
     case T_VAR:
@@ -141,10 +150,16 @@ const char *token_name(Tok token)
         return "USING";
 
     default:
-        return "UNKNOWN";
+        return token_unknown;
     }
 }
 
+/* Whether a byte is a token the tokenizer emits into a finished line */
+bool token_is_known(Tok token)
+{
+    return token_name(token) != token_unknown;
+}
+
 /* LIST command - display readable program listing */
 void cmd_list(void)
 {
@@ -154,20 +169,28 @@ void cmd_list(void)
     }
 }
 
+/* Numbers are listed as the PC-1211 displays them */
+static void list_number(double value)
+{
+    char text[NUMBER_TEXT_MAX];
+    number_format(value, text);
+    printf("%s", text);
+}
+
 /* LIST a specific line */
-void cmd_list_line(uint16_t line_num)
+void cmd_list_line(uint32_t line_num)
 {
     uint8_t *line_ptr = program_find_line(line_num);
     if (!line_ptr)
     {
-        printf("Line %d not found.\n", line_num);
+        printf("Line %u not found.\n", line_num);
         return;
     }
 
-    printf("%d ", get_line(line_ptr));
+    printf("%u ", get_line(line_ptr));
 
     const uint8_t *pos = get_tokens(line_ptr);
-    const uint8_t *end = get_tokens(line_ptr) + get_len(line_ptr) - 5; /* Subtract header and T_EOL */
+    const uint8_t *end = get_tokens(line_ptr) + get_tokens_len(line_ptr);
     bool need_space = false;
 
     while (pos < end && *pos != T_EOL)
@@ -181,10 +204,13 @@ void cmd_list_line(uint16_t line_num)
         switch (*pos)
         {
         case T_NUM:
+        case T_NUM16:
+        case T_INT8:
+        case T_INT16:
         {
-            double val = *(double *)(pos + 1);
-            printf("%g", val);
-            pos += 9;
+            double val = token_num_value(pos);
+            list_number(val);
+            pos += token_num_len(pos);
             break;
         }
 
@@ -232,10 +258,13 @@ void cmd_list_line(uint16_t line_num)
                 switch (*pos)
                 {
                 case T_NUM:
+                case T_NUM16:
+                case T_INT8:
+                case T_INT16:
                 {
-                    double val = *(double *)(pos + 1);
-                    printf("%g", val);
-                    pos += 9;
+                    double val = token_num_value(pos);
+                    list_number(val);
+                    pos += token_num_len(pos);
                     break;
                 }
                 case T_VAR:
@@ -308,10 +337,13 @@ void cmd_list_line(uint16_t line_num)
                 switch (*pos)
                 {
                 case T_NUM:
+                case T_NUM16:
+                case T_INT8:
+                case T_INT16:
                 {
-                    double val = *(double *)(pos + 1);
-                    printf("%g", val);
-                    pos += 9;
+                    double val = token_num_value(pos);
+                    list_number(val);
+                    pos += token_num_len(pos);
                     break;
                 }
                 case T_VAR:
@@ -385,38 +417,16 @@ void cmd_list_line(uint16_t line_num)
             break;
         }
 
-        case T_GOTO:
-        case T_GOSUB:
-        {
-            printf("%s", token_name(*pos));
-            pos++;
-            if (pos + 1 < end)
-            {
-                /* Should be followed by T_NUM with line number */
-                if (*pos == T_NUM)
-                {
-                    double line_val = *(double *)(pos + 1);
-                    printf(" %g", line_val);
-                    pos += 9;
-                }
-                else
-                {
-                    pos++;
-                }
-            }
-            break;
-        }
-
         case T_THEN:
         {
             printf("THEN");
             pos++;
-            if (pos < end && *pos == T_NUM)
+            if (pos < end && token_is_num(*pos))
             {
                 printf(" ");
-                double line_val = *(double *)(pos + 1);
-                printf("%g", line_val);
-                pos += 9;
+                double line_val = token_num_value(pos);
+                list_number(line_val);
+                pos += token_num_len(pos);
             }
             break;
         }
@@ -451,6 +461,15 @@ void cmd_list_line(uint16_t line_num)
     printf("\n");
 }
 
+/* Print a bound from the load-time analysis (debug dump) */
+static void disassemble_stack_bound(const char *name, int bound)
+{
+    if (bound < 0)
+        printf("%s: unknown (checked at run time)\n", name);
+    else
+        printf("%s: %d\n", name, bound);
+}
+
 /* Disassemble program (debug dump) */
 void disassemble_program(void)
 {
@@ -459,14 +478,16 @@ void disassemble_program(void)
     {
         disassemble_line(line_ptr);
     }
+    disassemble_stack_bound("GOSUB depth", g_program.call_depth);
+    disassemble_stack_bound("FOR depth", g_program.for_depth);
+    disassemble_stack_bound("Expression nesting", g_program.expr_depth);
 }
 
 /* Disassemble a single line (debug dump) */
 void disassemble_line(uint8_t *line_ptr)
 {
-    printf("Line %d (len=%d):\n", get_line(line_ptr), get_len(line_ptr));
-    int token_len = get_len(line_ptr) - 5; /* Subtract header and T_EOL */
-    disassemble_tokens(get_tokens(line_ptr), token_len);
+    printf("Line %u (len=%d):\n", get_line(line_ptr), get_len(line_ptr));
+    disassemble_tokens(get_tokens(line_ptr), get_tokens_len(line_ptr));
     printf("\n");
 }
 
@@ -483,10 +504,13 @@ void disassemble_tokens(const uint8_t *tokens, int len)
         switch (*pos)
         {
         case T_NUM:
+        case T_NUM16:
+        case T_INT8:
+        case T_INT16:
         {
-            double val = *(double *)(pos + 1);
+            double val = token_num_value(pos);
             printf(" (%g)", val);
-            pos += 9;
+            pos += token_num_len(pos);
             break;
         }
 
@@ -531,21 +555,21 @@ void disassemble_tokens(const uint8_t *tokens, int len)
         case T_GOTO:
         case T_GOSUB:
             pos++;
-            if (pos < end && *pos == T_NUM)
+            if (pos < end && token_is_num(*pos))
             {
-                double line_val = *(double *)(pos + 1);
+                double line_val = token_num_value(pos);
                 printf(" -> %g", line_val);
-                pos += 9;
+                pos += token_num_len(pos);
             }
             break;
 
         case T_THEN:
             pos++;
-            if (pos < end && *pos == T_NUM)
+            if (pos < end && token_is_num(*pos))
             {
-                double line_val = *(double *)(pos + 1);
+                double line_val = token_num_value(pos);
                 printf(" -> %g", line_val);
-                pos += 9;
+                pos += token_num_len(pos);
             }
             break;
 
@@ -6,7 +6,7 @@
 
 /* LIST command - display program listing */
 void cmd_list(void);
-void cmd_list_line(uint16_t line_num);
+void cmd_list_line(uint32_t line_num);
 
 /* Token disassembly for debugging */
 void disassemble_program(void);
@@ -15,5 +15,6 @@ void disassemble_tokens(const uint8_t *tokens, int len);
 
 /* Token name lookup */
 const char *token_name(Tok token);
+bool token_is_known(Tok token);
 
 #endif /* LISTING_H */
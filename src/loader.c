@@ -0,0 +1,785 @@
+#include "loader.h"
+#include "tokenizer.h"
+#include "program.h"
+#include "errors.h"
+#include "ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum
+{
+    LOAD_PARALLEL_MIN = 1 << 20, /* Smaller sources are tokenized sequentially */
+    LOAD_CHUNK_SIZE = 64 * 1024, /* Source bytes per chunk, up to the next newline */
+    LOAD_SLOTS = 32,             /* Chunks staged at once: workers wait for the merge beyond */
+    LOAD_STAGE_FACTOR = 8,       /* Staged bytes per source byte, at most (see loader_stage_line()) */
+    LOAD_SLOT_SIZE = LOAD_STAGE_FACTOR * LOAD_CHUNK_SIZE,
+    LOAD_STAGE_HDR_LEN = 7,      /* u16 token_len | u32 line | u8 consts_len */
+    LOAD_STAGE_LINE_MAX = LOAD_STAGE_HDR_LEN + TOKBUF_LINE_MAX + TOKBUF_LINE_MAX / 2 * sizeof(double)
+};
+
+/* Chunk of whole lines tokenized by a worker into its slot. Its lines are
+ * staged as header | tokens | consts (doubles), from staged up to staged_end */
+typedef struct
+{
+    const char *start;
+    const char *end;        /* After the last line's newline */
+    uint8_t *staged;        /* The slot, LOAD_SLOT_SIZE bytes */
+    uint8_t *staged_end;
+    const char *stopped_at; /* First line the worker did not stage, NULL */
+    bool done;              /* Staged, for the merge to take (under load_lock) */
+} LoadChunk;
+
+static int load_threads; /* 0: one per online CPU */
+static pthread_t load_workers[LOAD_THREADS_MAX];
+
+/* Chunk n is staged in slot n % LOAD_SLOTS. Workers cut the chunks as they
+ * take them, and wait while LOAD_SLOTS of them are not merged yet */
+static uint8_t load_stage[LOAD_SLOTS][LOAD_SLOT_SIZE];
+static LoadChunk load_chunks[LOAD_SLOTS];
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t load_chunk_done = PTHREAD_COND_INITIALIZER; /* The merge waits on it */
+static pthread_cond_t load_slot_free = PTHREAD_COND_INITIALIZER;  /* Workers wait on it */
+static const char *load_cut;     /* Where the next chunk starts */
+static const char *load_end;     /* End of the source */
+static int load_next_chunk;      /* Chunks taken by workers */
+static int load_merged;          /* Chunks merged */
+static bool load_stopping;       /* The merge has failed: workers take no more chunks */
+
+void load_set_threads(int threads)
+{
+    assert(0 <= threads && threads <= LOAD_THREADS_MAX);
+    load_threads = threads;
+}
+
+/* Length mapped for a source file of size bytes: whole pages, at least one zero byte after it */
+static size_t loader_map_len(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size / page + 1) * page;
+}
+
+/* Map a source file read only. It is mapped over an anonymous reservation one
+ * page longer, so the text is always followed by zero bytes: a last line
+ * without a newline still ends in NUL. NULL if it cannot be read */
+static const char *loader_map_file(const char *filename, size_t *size)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    char *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0)
+    {
+        *size = (size_t)st.st_size;
+        map = mmap(NULL, loader_map_len(*size), PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map != MAP_FAILED && *size > 0 &&
+            mmap(map, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            munmap(map, loader_map_len(*size));
+            map = MAP_FAILED;
+        }
+    }
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/* End of the line at line: its newline, or end */
+static const char *loader_line_end(const char *line, const char *end)
+{
+    const char *newline = memchr(line, '\n', end - line);
+    return newline ? newline : end;
+}
+
+/* Line number of a source line, 0 if it has none. *body is where its statements start */
+static long loader_line_number(const char *line, const char *line_end, const char **body)
+{
+    /* The whitespace strtol() skips, kept within the line */
+    const char *pos = line;
+    while (pos < line_end && isspace((unsigned char)*pos))
+    {
+        pos++;
+    }
+    char *endptr = (char *)pos;
+    long line_num = pos < line_end ? strtol(pos, &endptr, 10) : 0;
+    if (line_num <= 0 || line_num > (long)g_program.line_num_max || endptr == pos)
+        return 0;
+
+    /* Skip whitespace after line number */
+    while (*endptr == ' ' || *endptr == '\t')
+    {
+        endptr++;
+    }
+    *body = endptr;
+    return line_num;
+}
+
+/* Tokenize the lines from start to end and add them to the program */
+static bool loader_lines(const char *start, const char *end, int *lines_loaded)
+{
+    for (const char *line = start; line < end;)
+    {
+        const char *line_end = loader_line_end(line, end);
+
+        /* Skip empty lines */
+        if (line_end > line)
+        {
+            const char *body;
+            long line_num = loader_line_number(line, line_end, &body);
+            if (line_num == 0)
+            {
+                fprintf(stderr, "Invalid line number in: %.*s\n", (int)(line_end - line), line);
+                return false;
+            }
+
+            uint8_t tokens[TOKBUF_LINE_MAX];
+            int token_len;
+            if (!tokenize_line(body, (uint32_t)line_num, tokens, &token_len) ||
+                !program_load_line((uint32_t)line_num, tokens, token_len))
+                return false;
+            (*lines_loaded)++;
+        }
+        line = line_end + 1;
+    }
+    return true;
+}
+
+/* Parallel loading */
+
+/* Stage a tokenized line. Tokens take at most 2 bytes per source character
+ * and a deferred constant (2 characters or more) 10, so a line and its
+ * newline never stage more than LOAD_STAGE_FACTOR bytes per byte */
+static uint8_t *loader_stage_line(uint8_t *out, const Tokenizer *t)
+{
+    uint16_t token_len = (uint16_t)t->token_len;
+    uint32_t line_num = (uint32_t)t->line_num;
+    memcpy(out, &token_len, 2);
+    memcpy(out + 2, &line_num, 4);
+    out[6] = (uint8_t)t->consts_len;
+    out += LOAD_STAGE_HDR_LEN;
+    memcpy(out, t->tokens, t->token_len);
+    out += t->token_len;
+    memcpy(out, t->consts, t->consts_len * sizeof(double));
+    return out + t->consts_len * sizeof(double);
+}
+
+/* Tokenize a chunk into its slot, stopping at a line with an error or one
+ * the slot may have no room for: the merge redoes the rest sequentially */
+static void loader_tokenize_chunk(LoadChunk *chunk)
+{
+    Tokenizer t;
+    t.defer_consts = true;
+    uint8_t *out = chunk->staged;
+
+    for (const char *line = chunk->start; line < chunk->end;)
+    {
+        const char *line_end = loader_line_end(line, chunk->end);
+        if (line_end > line)
+        {
+            const char *body;
+            long line_num;
+            if (out + LOAD_STAGE_LINE_MAX > chunk->staged + LOAD_SLOT_SIZE ||
+                (line_num = loader_line_number(line, line_end, &body)) == 0 ||
+                tokenize_line_run(&t, body, (uint32_t)line_num) != ERR_NONE)
+            {
+                chunk->stopped_at = line;
+                break;
+            }
+            out = loader_stage_line(out, &t);
+        }
+        line = line_end + 1;
+    }
+    chunk->staged_end = out;
+}
+
+/* Take the next chunk, cutting it from the source, once its slot is free.
+ * NULL when the source is all taken or the merge has failed */
+static LoadChunk *loader_take_chunk(void)
+{
+    pthread_mutex_lock(&load_lock);
+    while (!load_stopping && load_cut < load_end && load_next_chunk - load_merged >= LOAD_SLOTS)
+    {
+        pthread_cond_wait(&load_slot_free, &load_lock);
+    }
+    LoadChunk *chunk = NULL;
+    if (!load_stopping && load_cut < load_end)
+    {
+        chunk = &load_chunks[load_next_chunk % LOAD_SLOTS];
+        chunk->staged = load_stage[load_next_chunk % LOAD_SLOTS];
+        chunk->start = load_cut;
+        chunk->end = load_end - load_cut > LOAD_CHUNK_SIZE ? loader_line_end(load_cut + LOAD_CHUNK_SIZE, load_end)
+                                                           : load_end;
+        if (chunk->end < load_end)
+            chunk->end++; /* Past the newline */
+        chunk->stopped_at = NULL;
+        chunk->done = false;
+        load_cut = chunk->end;
+        load_next_chunk++;
+    }
+    pthread_mutex_unlock(&load_lock);
+    return chunk;
+}
+
+static void *loader_worker(void *unused)
+{
+    (void)unused;
+    for (LoadChunk *chunk; (chunk = loader_take_chunk()) != NULL;)
+    {
+        loader_tokenize_chunk(chunk);
+        pthread_mutex_lock(&load_lock);
+        chunk->done = true;
+        pthread_cond_broadcast(&load_chunk_done);
+        pthread_mutex_unlock(&load_lock);
+    }
+    return NULL;
+}
+
+/* Size of a staged token: the deferred constants are T_NUM with an index into the line's */
+static int loader_token_len(const uint8_t *token)
+{
+    switch (*token)
+    {
+    case T_NUM:
+    case T_INT8:
+    case T_VAR:
+    case T_SVAR:
+        return 2;
+    case T_INT16:
+        return 3;
+    case T_STR:
+        return 2 + token[1];
+    default:
+        return 1;
+    }
+}
+
+/* Rebuild a staged line's tokens in t. Its constants enter the pool token
+ * by token, and the line grows by T_NUM16 as they do, exactly as when the
+ * sequential tokenizer emitted them: an error is the one it would report */
+static ErrorCode loader_unstage_line(const uint8_t *staged, const uint8_t **next, Tokenizer *t)
+{
+    uint16_t staged_len;
+    uint32_t line_num;
+    memcpy(&staged_len, staged, 2);
+    memcpy(&line_num, staged + 2, 4);
+    int consts_len = staged[6];
+    const uint8_t *tokens = staged + LOAD_STAGE_HDR_LEN;
+    const uint8_t *consts = tokens + staged_len;
+    *next = consts + consts_len * sizeof(double);
+
+    t->defer_consts = false;
+    t->line_num = (int)line_num;
+    t->token_len = 0;
+    t->error = ERR_NONE;
+    for (const uint8_t *pos = tokens; pos < consts && t->error == ERR_NONE; pos += loader_token_len(pos))
+    {
+        int len = loader_token_len(pos);
+        if (*pos == T_NUM)
+        {
+            double value;
+            memcpy(&value, consts + pos[1] * sizeof(double), sizeof(double));
+            emit_token_num(t, value);
+        }
+        else if (t->token_len + len > TOKBUF_LINE_MAX)
+        {
+            t->error = ERR_LINE_TOO_LONG;
+        }
+        else
+        {
+            memcpy(t->tokens + t->token_len, pos, len);
+            t->token_len += len;
+        }
+    }
+    return t->error;
+}
+
+/* Add a staged line to the program */
+static bool loader_merge_line(const uint8_t *staged, const uint8_t **next)
+{
+    Tokenizer t;
+    if (loader_unstage_line(staged, next, &t) != ERR_NONE)
+    {
+        error_report(t.error, t.line_num);
+        return false;
+    }
+    return program_load_line((uint32_t)t.line_num, t.tokens, t.token_len);
+}
+
+/* The next chunk to merge once staged, NULL when all of them are merged */
+static LoadChunk *loader_next_staged(void)
+{
+    LoadChunk *chunk = &load_chunks[load_merged % LOAD_SLOTS];
+    pthread_mutex_lock(&load_lock);
+    while (load_merged < load_next_chunk ? !chunk->done : !load_stopping && load_cut < load_end)
+    {
+        pthread_cond_wait(&load_chunk_done, &load_lock);
+    }
+    bool staged = load_merged < load_next_chunk;
+    pthread_mutex_unlock(&load_lock);
+    return staged ? chunk : NULL;
+}
+
+/* Free the merged chunk's slot, and stop the workers if the merge failed */
+static void loader_chunk_merged(bool loaded)
+{
+    pthread_mutex_lock(&load_lock);
+    load_merged++;
+    if (!loaded)
+        load_stopping = true;
+    pthread_cond_broadcast(&load_slot_free);
+    pthread_mutex_unlock(&load_lock);
+}
+
+/* Tokenize on worker threads and merge in file order. false if no thread
+ * could be started: nothing was loaded then */
+static bool loader_parallel(const char *source, size_t size, int threads, int *lines_loaded, bool *loaded)
+{
+    load_cut = source;
+    load_end = source + size;
+    load_next_chunk = 0;
+    load_merged = 0;
+    load_stopping = false;
+    int started = 0;
+    while (started < threads && pthread_create(&load_workers[started], NULL, loader_worker, NULL) == 0)
+    {
+        started++;
+    }
+    if (started == 0)
+        return false;
+
+    *loaded = true;
+    for (LoadChunk *chunk; (chunk = loader_next_staged()) != NULL;)
+    {
+        for (const uint8_t *pos = chunk->staged; *loaded && pos < chunk->staged_end; (*lines_loaded)++)
+        {
+            *loaded = loader_merge_line(pos, &pos);
+        }
+        if (*loaded && chunk->stopped_at)
+            *loaded = loader_lines(chunk->stopped_at, chunk->end, lines_loaded);
+        loader_chunk_merged(*loaded);
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(load_workers[i], NULL);
+    }
+    return true;
+}
+
+/* Tokenize a file in one pass over its mapping, without copying the text */
+bool load_file(const char *filename)
+{
+    size_t size = 0;
+    const char *source = loader_map_file(filename, &size);
+    if (!source)
+    {
+        fprintf(stderr, "Cannot open file: %s\n", filename);
+        return false;
+    }
+
+    int threads = load_threads;
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus > LOAD_THREADS_MAX ? LOAD_THREADS_MAX : (int)cpus;
+    }
+
+    int lines_loaded = 0;
+    bool loaded = false;
+    if (threads < 2 || size < LOAD_PARALLEL_MIN || !loader_parallel(source, size, threads, &lines_loaded, &loaded))
+        loaded = loader_lines(source, source + size, &lines_loaded);
+
+    munmap((void *)source, loader_map_len(size));
+    program_load_finish();
+    if (loaded)
+        printf("Loaded %d lines\n", lines_loaded);
+    return loaded;
+}
+
+/* Streaming: a thread tokenizes the file in order while the program runs,
+ * staging its lines in a ring. The VM thread enters them into the program
+ * when it runs out of lines (see program_set_more()), so the program is only
+ * ever touched by the thread running it */
+
+enum
+{
+    LOAD_STREAM_RING_SIZE = 1 << 20, /* A power of two */
+    LOAD_STREAM_BATCH = 64 * 1024    /* Staged bytes published together */
+};
+
+/* Why no more lines come: ERR_NONE at the end of the file */
+typedef struct
+{
+    ErrorCode error;
+    uint32_t line_num;
+    const char *problem;  /* What is wrong with bad_line */
+    const char *bad_line; /* Line that could not be staged for its number, NULL */
+    const char *bad_line_end;
+} StreamEnd;
+
+static uint8_t stream_ring[LOAD_STREAM_RING_SIZE];
+static RingSync stream_sync;
+static pthread_t stream_thread;
+static const char *stream_source;
+static size_t stream_size;
+static int stream_stopping;        /* The run is over: the thread stops at the next line */
+static StreamEnd stream_end;       /* Thread: set before it closes the ring */
+static StreamEnd stream_failed;    /* VM thread: no more lines will be entered, for this reason */
+static uint32_t stream_last_line;  /* VM thread: last line number entered */
+
+/* Thread: append a staged line to the ring after the pending ones, waiting
+ * only while it is full. The lines are published in batches, or at once
+ * when the VM thread has run out of lines */
+static void loader_stream_push(const uint8_t *staged, uint32_t len, uint32_t *pending)
+{
+    ring_wait_room(&stream_sync, *pending + len);
+    uint32_t offset = (stream_sync.head + *pending) & (LOAD_STREAM_RING_SIZE - 1);
+    uint32_t first = LOAD_STREAM_RING_SIZE - offset; /* Up to the wrap */
+    if (first > len)
+        first = len;
+    memcpy(stream_ring + offset, staged, first);
+    memcpy(stream_ring, staged + first, len - first);
+    *pending += len;
+
+    if (*pending >= LOAD_STREAM_BATCH || ring_room(&stream_sync) == LOAD_STREAM_RING_SIZE)
+    {
+        ring_publish(&stream_sync, *pending);
+        *pending = 0;
+    }
+}
+
+/* VM thread: copy len bytes from skip bytes into the ring's unread part */
+static void loader_stream_peek(uint8_t *out, uint32_t skip, uint32_t len)
+{
+    uint32_t offset = (stream_sync.tail + skip) & (LOAD_STREAM_RING_SIZE - 1);
+    uint32_t first = LOAD_STREAM_RING_SIZE - offset;
+    if (first > len)
+        first = len;
+    memcpy(out, stream_ring + offset, first);
+    memcpy(out + first, stream_ring, len - first);
+}
+
+static void *loader_stream_tokenize(void *unused)
+{
+    (void)unused;
+    Tokenizer t;
+    t.defer_consts = true;
+    uint8_t staged[LOAD_STAGE_LINE_MAX];
+    uint32_t pending = 0; /* Staged bytes not published yet */
+    const char *end = stream_source + stream_size;
+    uint32_t last_line = 0;
+
+    for (const char *line = stream_source; line < end && !__atomic_load_n(&stream_stopping, __ATOMIC_SEQ_CST);)
+    {
+        const char *line_end = loader_line_end(line, end);
+        if (line_end > line)
+        {
+            const char *body;
+            long line_num = loader_line_number(line, line_end, &body);
+            if (line_num == 0)
+            {
+                stream_end = (StreamEnd){ERR_BAD_LINE_NUMBER, 0, "Invalid line number", line, line_end};
+                break;
+            }
+            /* Entered lines never move, so an earlier or repeated number cannot be placed */
+            if ((uint32_t)line_num <= last_line)
+            {
+                stream_end = (StreamEnd){ERR_BAD_LINE_NUMBER, (uint32_t)line_num, "Line out of order", line, line_end};
+                break;
+            }
+            ErrorCode error = tokenize_line_run(&t, body, (uint32_t)line_num);
+            if (error != ERR_NONE)
+            {
+                stream_end = (StreamEnd){error, (uint32_t)line_num, NULL, NULL, NULL};
+                break;
+            }
+            last_line = (uint32_t)line_num;
+            loader_stream_push(staged, (uint32_t)(loader_stage_line(staged, &t) - staged), &pending);
+        }
+        line = line_end + 1;
+    }
+    ring_publish(&stream_sync, pending);
+    ring_close(&stream_sync); /* Publishes stream_end */
+    return NULL;
+}
+
+/* Constants of a staged line not in the pool yet, each counted once */
+static int loader_new_consts(const uint8_t *consts, int consts_len)
+{
+    int count = 0;
+    for (int i = 0; i < consts_len; i++)
+    {
+        double value;
+        memcpy(&value, consts + i * sizeof(double), sizeof(double));
+        bool known = program_has_const(value);
+        for (int j = 0; j < i && !known; j++)
+        {
+            double earlier;
+            memcpy(&earlier, consts + j * sizeof(double), sizeof(double));
+            known = earlier == value;
+        }
+        if (!known)
+            count++;
+    }
+    return count;
+}
+
+/* VM thread: rebuild a staged line's tokens in t for the running program.
+ * The pool is checked for room first: program_add_const() must not exit under the run */
+static ErrorCode loader_unstage_running(const uint8_t *staged, Tokenizer *t)
+{
+    uint16_t staged_len;
+    memcpy(&staged_len, staged, 2);
+    if (!program_consts_fit(loader_new_consts(staged + LOAD_STAGE_HDR_LEN + staged_len, staged[6])))
+        return ERR_PROGRAM_TOO_LARGE;
+
+    const uint8_t *next;
+    return loader_unstage_line(staged, &next, t);
+}
+
+/* VM thread: enter a staged line. What program_load_line() would report is
+ * checked first, as it must neither exit under the running program nor sort
+ * its records: the thread only stages lines in increasing order */
+static ErrorCode loader_stream_enter(const uint8_t *staged, uint32_t *line_num)
+{
+    memcpy(line_num, staged + 2, 4);
+    assert(*line_num > stream_last_line); /* The thread stops at a line out of order */
+
+    Tokenizer t;
+    ErrorCode error = loader_unstage_running(staged, &t);
+    if (error != ERR_NONE)
+        return error;
+    if (!program_record_fits(t.token_len, 0))
+        return ERR_PROGRAM_TOO_LARGE;
+
+    program_load_line(*line_num, t.tokens, t.token_len);
+    stream_last_line = *line_num;
+    return ERR_NONE;
+}
+
+/* VM thread: enter every line staged so far, stopping at one that fails.
+ * Returns the number entered */
+static int loader_stream_enter_staged(void)
+{
+    int entered = 0;
+    for (uint32_t used = ring_used(&stream_sync); used > 0;)
+    {
+        uint8_t staged[LOAD_STAGE_LINE_MAX];
+        loader_stream_peek(staged, 0, LOAD_STAGE_HDR_LEN);
+        uint16_t staged_len;
+        memcpy(&staged_len, staged, 2);
+        uint32_t len = LOAD_STAGE_HDR_LEN + staged_len + staged[6] * sizeof(double);
+        assert(len <= used);
+        loader_stream_peek(staged + LOAD_STAGE_HDR_LEN, LOAD_STAGE_HDR_LEN, len - LOAD_STAGE_HDR_LEN);
+        ring_release(&stream_sync, len);
+        used -= len;
+
+        uint32_t line_num;
+        ErrorCode error = loader_stream_enter(staged, &line_num);
+        if (error != ERR_NONE)
+        {
+            stream_failed = (StreamEnd){error, line_num, NULL, NULL, NULL};
+            __atomic_store_n(&stream_stopping, 1, __ATOMIC_SEQ_CST);
+            break;
+        }
+        entered++;
+    }
+    return entered;
+}
+
+/* program_set_more() hook: the lines tokenized since the last call, waiting
+ * for one. Once none will come because of a bad line, the run stops with its
+ * error, as the load would have */
+static bool loader_stream_more(void)
+{
+    if (stream_failed.error == ERR_NONE)
+    {
+        if (ring_wait_data(&stream_sync))
+        {
+            if (loader_stream_enter_staged() > 0)
+                return true;
+        }
+        else
+        {
+            stream_failed = stream_end;
+        }
+    }
+    if (stream_failed.error == ERR_NONE)
+        return false;
+
+    if (stream_failed.bad_line)
+        fprintf(stderr, "%s in: %.*s\n", stream_failed.problem,
+                (int)(stream_failed.bad_line_end - stream_failed.bad_line), stream_failed.bad_line);
+    error_fatal(stream_failed.error, (int)stream_failed.line_num);
+    return false; /* Never reached */
+}
+
+bool load_stream_start(const char *filename)
+{
+    stream_source = loader_map_file(filename, &stream_size);
+    if (!stream_source)
+    {
+        fprintf(stderr, "Cannot open file: %s\n", filename);
+        return false;
+    }
+
+    stream_stopping = 0;
+    stream_end = (StreamEnd){ERR_NONE, 0, NULL, NULL, NULL};
+    stream_failed = stream_end;
+    stream_last_line = 0;
+    if (!ring_init(&stream_sync, LOAD_STREAM_RING_SIZE) ||
+        pthread_create(&stream_thread, NULL, loader_stream_tokenize, NULL) != 0)
+    {
+        munmap((void *)stream_source, loader_map_len(stream_size));
+        fprintf(stderr, "Cannot start the loader thread\n");
+        return false;
+    }
+    program_set_more(loader_stream_more);
+    return true;
+}
+
+void load_stream_finish(void)
+{
+    program_set_more(NULL);
+    __atomic_store_n(&stream_stopping, 1, __ATOMIC_SEQ_CST);
+    while (ring_wait_data(&stream_sync))
+    {
+        ring_release(&stream_sync, ring_used(&stream_sync));
+    }
+    pthread_join(stream_thread, NULL);
+    ring_destroy(&stream_sync);
+    munmap((void *)stream_source, loader_map_len(stream_size));
+}
+
+/* Lazy loading: the file stays mapped, and each line is loaded as a stub
+ * holding where its statements start, with room for their tokens. The run
+ * tokenizes a line the first time it enters it (see program_set_lazy()).
+ * Lines starting with a label are tokenized at once, for the label lookups */
+
+enum
+{
+    LOAD_LAZY_STUB_LEN = 5 /* T_LAZY | u32 source offset */
+};
+
+static const char *lazy_source;
+
+/* Room for the tokens of a line's statements: at most 2 bytes per character
+ * (see loader_stage_line()), and never more than a line can have */
+static int loader_lazy_room(const char *body, const char *line_end)
+{
+    size_t room = 2 * (size_t)(line_end - body);
+    if (room > TOKBUF_LINE_MAX)
+        room = TOKBUF_LINE_MAX;
+    return room < LOAD_LAZY_STUB_LEN ? LOAD_LAZY_STUB_LEN : (int)room;
+}
+
+/* program_set_lazy() hook: tokenize a stub's line over it. Its constants
+ * enter the pool now, and a bad line, or one the program has no more room
+ * for, stops the run with its error */
+static void loader_lazy_tokenize(uint8_t *line_ptr)
+{
+    const uint8_t *stub = get_tokens(line_ptr);
+    uint32_t offset = (uint32_t)stub[1] | (uint32_t)stub[2] << 8 | (uint32_t)stub[3] << 16 | (uint32_t)stub[4] << 24;
+    uint32_t line_num = get_line(line_ptr);
+
+    Tokenizer t;
+    t.defer_consts = true;
+    ErrorCode error = tokenize_line_run(&t, lazy_source + offset, line_num);
+    if (error == ERR_NONE)
+    {
+        uint8_t staged[LOAD_STAGE_LINE_MAX];
+        loader_stage_line(staged, &t);
+        error = loader_unstage_running(staged, &t);
+    }
+    if (error == ERR_NONE && !program_fill_line(line_ptr, t.tokens, t.token_len))
+        error = ERR_PROGRAM_TOO_LARGE;
+    if (error != ERR_NONE)
+        error_fatal(error, (int)line_num);
+}
+
+/* Load a line as a stub, or tokenized if it starts with a label */
+static bool loader_lazy_line(const char *body, const char *line_end, uint32_t line_num)
+{
+    uint8_t tokens[TOKBUF_LINE_MAX];
+    int token_len;
+    if (*body == '"')
+    {
+        return tokenize_line(body, line_num, tokens, &token_len) &&
+               program_load_line(line_num, tokens, token_len);
+    }
+
+    uint32_t offset = (uint32_t)(body - lazy_source);
+    token_len = loader_lazy_room(body, line_end);
+    memset(tokens, T_EOL, token_len);
+    tokens[0] = T_LAZY;
+    for (int i = 0; i < 4; i++)
+    {
+        tokens[1 + i] = (uint8_t)(offset >> 8 * i);
+    }
+    return program_load_stub(line_num, tokens, token_len);
+}
+
+bool load_file_lazy(const char *filename, bool validate)
+{
+    size_t size = 0;
+    lazy_source = loader_map_file(filename, &size);
+    if (!lazy_source)
+    {
+        fprintf(stderr, "Cannot open file: %s\n", filename);
+        return false;
+    }
+    if (size > UINT32_MAX)
+    {
+        fprintf(stderr, "File too large to load lazily: %s\n", filename);
+        munmap((void *)lazy_source, loader_map_len(size));
+        return false;
+    }
+
+    Tokenizer t;
+    t.defer_consts = true;
+    int lines_loaded = 0;
+    bool loaded = true;
+    const char *end = lazy_source + size;
+    for (const char *line = lazy_source; loaded && line < end;)
+    {
+        const char *line_end = loader_line_end(line, end);
+        if (line_end > line)
+        {
+            const char *body;
+            long line_num = loader_line_number(line, line_end, &body);
+            if (line_num == 0)
+            {
+                fprintf(stderr, "Invalid line number in: %.*s\n", (int)(line_end - line), line);
+                loaded = false;
+                break;
+            }
+            /* Validation: the syntax errors now, the constants when the line runs */
+            ErrorCode error = validate ? tokenize_line_run(&t, body, (uint32_t)line_num) : ERR_NONE;
+            if (error != ERR_NONE)
+            {
+                error_report(error, (int)line_num);
+                loaded = false;
+                break;
+            }
+            loaded = loader_lazy_line(body, line_end, (uint32_t)line_num);
+            lines_loaded++;
+        }
+        line = line_end + 1;
+    }
+
+    /* The mapping stays for the run: the stubs point into it */
+    program_load_finish();
+    if (!loaded)
+        return false;
+    program_set_lazy(loader_lazy_tokenize);
+    printf("Loaded %d lines\n", lines_loaded);
+    return true;
+}
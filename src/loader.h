@@ -0,0 +1,44 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdbool.h>
+
+/* Source file loading: the file is mapped and tokenized in place, line by
+ * line, into the program (see program_load_line()).
+ *
+ * Large files are tokenized in parallel: the source is cut into chunks of
+ * whole lines, worker threads tokenize them into a fixed set of static
+ * staging slots with the pool constants left aside, and the main thread
+ * merges the chunks in file order, entering the constants as it goes and
+ * freeing their slots for the workers. If no thread can be started, the file
+ * is tokenized sequentially. The program, the constant pool
+ * and the error reported (the first bad line of the file) are the same as
+ * when tokenizing sequentially. */
+
+enum
+{
+    LOAD_THREADS_MAX = 16
+};
+
+/* Tokenizer threads: 0 (default) one per online CPU, 1 sequential */
+void load_set_threads(int threads);
+
+/* Load a source file into the program, false on an error (reported) */
+bool load_file(const char *filename);
+
+/* Lazy loading: load a file's lines as stubs, each tokenized the first time
+ * the run enters it (see program_set_lazy()). A bad line stops the run with
+ * its error when the run gets there; validate checks every line's syntax
+ * now, reporting as load_file() would. The file stays mapped */
+bool load_file_lazy(const char *filename, bool validate);
+
+/* Streaming: start tokenizing a file on a thread, its lines entering the
+ * program as the run reaches them (see program_set_more()). The lines must
+ * come in increasing order: one out of order, or repeated, is a bad line. A
+ * bad line stops the run with its error when the run needs it. false if the file cannot be read (reported) */
+bool load_stream_start(const char *filename);
+
+/* After the run: stop the thread, the program keeps the lines it has */
+void load_stream_finish(void);
+
+#endif /* LOADER_H */
@@ -5,23 +5,80 @@
 #include "opcodes.h"
 #include "program.h"
 #include "tokenizer.h"
+#include "loader.h"
+#include "image.h"
 #include "listing.h"
 #include "vm.h"
+#include "analysis.h"
 #include "errors.h"
+#include "output.h"
+#include "input.h"
+#include "vardump.h"
+#include "vclock.h"
 
 void print_usage(const char *program_name)
 {
     printf("PC-1211 BASIC Interpreter v0.5\n");
     printf("Usage: %s <program.bas> [options]\n", program_name);
+    printf("       %s --load-image <program.pcb> [options]\n", program_name);
     printf("Options:\n");
     printf("  --list           Show program listing\n");
     printf("  --dump           Show token dump (debug)\n");
     printf("  --run            Execute program\n");
     printf("  --aread-value N  Set AREAD numeric value to N (default: 0.0)\n");
     printf("  --aread-string S Set AREAD string value to S\n");
+    printf("  --extended       Lift the PC-1211 memory limits (32 bit line numbers, A(n) up to %d)\n", VARS_EXT_MAX);
+    printf("  --max-bytes N    Extended program size limit (default and max: %d)\n", PROG_EXT_MAX_BYTES);
+    printf("  --max-lines N    Extended line count limit (default and max: %d)\n", LINES_EXT_MAX);
+    printf("  --load-threads N Threads tokenizing a large file (default: one per CPU, 1: none)\n");
+    printf("  --save-image F   Save the tokenized program to image file F\n");
+    printf("  --load-image F   Load the program from image file F instead of a source file\n");
+    printf("  --stream         With --run: start running while the file loads (lines in order)\n");
+    printf("  --lazy           With --run: tokenize each line when the run first reaches it\n");
+    printf("  --validate       With --lazy: check the syntax of every line at load\n");
+    printf("  --var-file F     Extended A(n) pages in file F instead of memory\n");
+    printf("  --output F       Write the program output to file F instead of stdout\n");
+    printf("  --async-output   Write the program output from a separate thread\n");
+    printf("  --input-file F   Feed INPUT from file F, one value per line\n");
+    printf("  --input-inline S Feed INPUT from S, values separated by commas\n");
+    printf("  --input-eof P    At the end of the input: keep (default), end or error\n");
+    printf("  --input-prefetch Read stdin ahead on a separate thread\n");
+    printf("  --dump-vars=F    After the run, write the variables as json or bin\n");
+    printf("  --dump-slots N:M Variables A(N) to A(M) to dump (default: 1:%d)\n", VARS_MAX);
+    printf("  --dump-fd N      File descriptor to dump to (default: 1)\n");
+    printf("  --clock M        PAUSE/BEEP timing: real (default), scaled or instant\n");
+    printf("  --clock-scale F  Scaled clock: wait F times the device time\n");
+    printf("  --beep-wait      BEEP waits for its tone (follows --clock)\n");
     printf("  --help           Show this help\n");
 }
 
+/* Parse a "first:last" A(n) range, checked against vars_max once it is known */
+static bool parse_slots(const char *arg, int *first, int *last)
+{
+    char *endptr;
+    long n = strtol(arg, &endptr, 10);
+    if (endptr == arg || *endptr != ':')
+        return false;
+    const char *last_arg = endptr + 1;
+    long m = strtol(last_arg, &endptr, 10);
+    if (endptr == last_arg || *endptr != '\0' || n < 1 || m < n || m > VARS_EXT_MAX)
+        return false;
+    *first = (int)n;
+    *last = (int)m;
+    return true;
+}
+
+/* Parse a limit argument in 1..max */
+static bool parse_limit(const char *arg, int max, int *value)
+{
+    char *endptr;
+    long n = strtol(arg, &endptr, 10);
+    if (endptr == arg || *endptr != '\0' || n < 1 || n > max)
+        return false;
+    *value = (int)n;
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 2)
@@ -35,6 +92,28 @@ int main(int argc, char *argv[])
     bool show_dump = false;
     bool run_program = false;
     const char *filename = NULL;
+    const char *save_image = NULL;
+    const char *load_image = NULL;
+    bool stream = false;
+    bool lazy = false;
+    bool validate = false;
+    bool extended = false;
+    int max_bytes = PROG_EXT_MAX_BYTES;
+    int max_lines = LINES_EXT_MAX;
+    const char *var_file = NULL;
+    const char *output_file = NULL;
+    bool async_output = false;
+    const char *input_file = NULL;
+    const char *input_inline = NULL;
+    InputEofPolicy input_eof = INPUT_EOF_KEEP;
+    bool input_prefetch = false;
+    VarDumpFormat dump_format = VAR_DUMP_NONE;
+    int dump_first = 1;
+    int dump_last = VARS_MAX;
+    int dump_fd = 1;
+    VClockMode clock_mode = VCLOCK_REAL;
+    double clock_scale = 1.0;
+    bool beep_wait = false;
 
     for (int i = 1; i < argc; i++)
     {
@@ -77,6 +156,215 @@ int main(int argc, char *argv[])
                 return 1;
             }
         }
+        else if (strcmp(argv[i], "--extended") == 0)
+        {
+            extended = true;
+        }
+        else if (strcmp(argv[i], "--max-bytes") == 0)
+        {
+            if (i + 1 < argc && parse_limit(argv[++i], PROG_EXT_MAX_BYTES, &max_bytes))
+            {
+                extended = true;
+            }
+            else
+            {
+                fprintf(stderr, "--max-bytes requires a size from 1 to %d\n", PROG_EXT_MAX_BYTES);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--max-lines") == 0)
+        {
+            if (i + 1 < argc && parse_limit(argv[++i], LINES_EXT_MAX, &max_lines))
+            {
+                extended = true;
+            }
+            else
+            {
+                fprintf(stderr, "--max-lines requires a count from 1 to %d\n", LINES_EXT_MAX);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--load-threads") == 0)
+        {
+            int threads;
+            if (i + 1 < argc && parse_limit(argv[++i], LOAD_THREADS_MAX, &threads))
+            {
+                load_set_threads(threads);
+            }
+            else
+            {
+                fprintf(stderr, "--load-threads requires a count from 1 to %d\n", LOAD_THREADS_MAX);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--save-image") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                save_image = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "--save-image requires a file name\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--load-image") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                load_image = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "--load-image requires a file name\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            stream = true;
+        }
+        else if (strcmp(argv[i], "--lazy") == 0)
+        {
+            lazy = true;
+        }
+        else if (strcmp(argv[i], "--validate") == 0)
+        {
+            validate = true;
+        }
+        else if (strcmp(argv[i], "--var-file") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                var_file = argv[++i];
+                extended = true;
+            }
+            else
+            {
+                fprintf(stderr, "--var-file requires a file name\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                output_file = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "--output requires a file name\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--async-output") == 0)
+        {
+            async_output = true;
+        }
+        else if (strcmp(argv[i], "--input-file") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                input_file = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "--input-file requires a file name\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--input-inline") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                input_inline = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "--input-inline requires a list of values\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--input-prefetch") == 0)
+        {
+            input_prefetch = true;
+        }
+        else if (strncmp(argv[i], "--dump-vars=", 12) == 0)
+        {
+            const char *format = argv[i] + 12;
+            if (strcmp(format, "json") == 0)
+                dump_format = VAR_DUMP_JSON;
+            else if (strcmp(format, "bin") == 0)
+                dump_format = VAR_DUMP_BIN;
+            else
+            {
+                fprintf(stderr, "--dump-vars requires json or bin\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dump-slots") == 0)
+        {
+            if (i + 1 >= argc || !parse_slots(argv[++i], &dump_first, &dump_last))
+            {
+                fprintf(stderr, "--dump-slots requires a range N:M with 1 <= N <= M\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dump-fd") == 0)
+        {
+            if (i + 1 >= argc || !parse_limit(argv[++i], INT32_MAX, &dump_fd))
+            {
+                fprintf(stderr, "--dump-fd requires a file descriptor number\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--clock") == 0)
+        {
+            const char *mode = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(mode, "real") == 0)
+                clock_mode = VCLOCK_REAL;
+            else if (strcmp(mode, "scaled") == 0)
+                clock_mode = VCLOCK_SCALED;
+            else if (strcmp(mode, "instant") == 0)
+                clock_mode = VCLOCK_INSTANT;
+            else
+            {
+                fprintf(stderr, "--clock requires real, scaled or instant\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--clock-scale") == 0)
+        {
+            char *endptr = NULL;
+            if (i + 1 < argc)
+                clock_scale = strtod(argv[++i], &endptr);
+            if (!endptr || *endptr != '\0' || !(clock_scale >= 0))
+            {
+                fprintf(stderr, "--clock-scale requires a factor >= 0\n");
+                return 1;
+            }
+            clock_mode = VCLOCK_SCALED;
+        }
+        else if (strcmp(argv[i], "--beep-wait") == 0)
+        {
+            beep_wait = true;
+        }
+        else if (strcmp(argv[i], "--input-eof") == 0)
+        {
+            const char *policy = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(policy, "keep") == 0)
+                input_eof = INPUT_EOF_KEEP;
+            else if (strcmp(policy, "end") == 0)
+                input_eof = INPUT_EOF_END;
+            else if (strcmp(policy, "error") == 0)
+                input_eof = INPUT_EOF_ERROR;
+            else
+            {
+                fprintf(stderr, "--input-eof requires keep, end or error\n");
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "--help") == 0)
         {
             print_usage(argv[0]);
@@ -93,25 +381,115 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (!filename)
+    if (!filename && !load_image)
     {
         fprintf(stderr, "No input file specified\n");
         return 1;
     }
+    if (filename && load_image)
+    {
+        fprintf(stderr, "Give either a source file or --load-image, not both\n");
+        return 1;
+    }
+    if (stream && (!run_program || show_list || show_dump || save_image || load_image))
+    {
+        fprintf(stderr, "--stream only runs a source file: use it with --run alone\n");
+        return 1;
+    }
+    if (lazy && (!run_program || show_list || show_dump || save_image || load_image || stream))
+    {
+        fprintf(stderr, "--lazy only runs a source file: use it with --run alone\n");
+        return 1;
+    }
+    if (validate && !lazy)
+    {
+        fprintf(stderr, "--validate goes with --lazy\n");
+        return 1;
+    }
 
     /* Initialize system */
     program_init();
     vm_init();
+    output_init();
+    input_init();
+    input_set_eof_policy(input_eof);
+    vclock_init();
+    vclock_set_mode(clock_mode, clock_scale);
+    vclock_set_tone_wait(beep_wait);
+    if (extended)
+    {
+        program_set_extended(max_bytes, max_lines);
+    }
+    if (dump_last > g_program.vars_max)
+    {
+        fprintf(stderr, "--dump-slots goes past A(%d)\n", g_program.vars_max);
+        return 1;
+    }
+    if (var_file && !var_map_file(var_file))
+    {
+        fprintf(stderr, "Cannot map variable file: %s\n", var_file);
+        return 1;
+    }
+    if (output_file && !output_open_file(output_file))
+    {
+        fprintf(stderr, "Cannot create output file: %s\n", output_file);
+        return 1;
+    }
+    if (input_file && !input_open_file(input_file))
+    {
+        fprintf(stderr, "Cannot read input file: %s\n", input_file);
+        return 1;
+    }
+    if (input_inline)
+    {
+        input_set_inline(input_inline);
+    }
+    if (input_prefetch && input_is_interactive() && !input_start_reader())
+    {
+        fprintf(stderr, "Cannot start the input thread\n");
+        return 1;
+    }
+    if (async_output && !output_start_writer())
+    {
+        fprintf(stderr, "Cannot start the output thread\n");
+        return 1;
+    }
 
     printf("PC-1211 BASIC Interpreter v0.5\n");
-    printf("Loading: %s\n", filename);
+    printf("Loading: %s\n", load_image ? load_image : filename);
 
-    /* Load and tokenize program */
-    if (!tokenize_file(filename))
+    /* Load and tokenize program, or take it as it was saved. A streamed or
+     * lazily loaded program is tokenized as it runs, without the stack analysis */
+    if (stream)
+    {
+        if (!load_stream_start(filename))
+        {
+            fprintf(stderr, "Failed to load program\n");
+            return 1;
+        }
+    }
+    else if (lazy)
+    {
+        if (!load_file_lazy(filename, validate))
+        {
+            fprintf(stderr, "Failed to load program\n");
+            return 1;
+        }
+    }
+    else if (load_image ? !image_load(load_image) : !load_file(filename))
     {
         fprintf(stderr, "Failed to load program\n");
         return 1;
     }
+    else
+    {
+        analyze_program();
+    }
+    if (save_image && !image_save(save_image))
+    {
+        fprintf(stderr, "Cannot write image file: %s\n", save_image);
+        return 1;
+    }
 
     /* Execute requested operations */
     if (show_dump)
@@ -130,14 +508,28 @@ int main(int argc, char *argv[])
     {
         printf("\nExecuting program:\n");
         vm_run();
+        if (stream)
+            load_stream_finish();
 
-        /* Return non-zero exit code if there were errors during execution */
-        if (error_get_code() != ERR_NONE)
+        /* Time the run would have taken on the device, when it was not all waited for */
+        if (clock_mode != VCLOCK_REAL)
         {
-            return 1;
+            fprintf(stderr, "Virtual time: %.3f s\n", vclock_usec() / 1e6);
         }
     }
 
+    if (dump_format != VAR_DUMP_NONE && !var_dump(dump_format, dump_fd, dump_first, dump_last))
+    {
+        fprintf(stderr, "Cannot write the variable dump to file descriptor %d\n", dump_fd);
+        return 1;
+    }
+
+    /* Return non-zero exit code if there were errors during execution */
+    if (run_program && error_get_code() != ERR_NONE)
+    {
+        return 1;
+    }
+
     /* If no specific action requested, just show that we loaded it */
     if (!show_list && !show_dump && !run_program)
     {
@@ -8,12 +8,16 @@ typedef enum
 {
     /* Core tokens */
     T_EOL = 0x00,   /* end of line record */
-    T_NUM = 0x01,   /* <8 bytes double> */
+    T_NUM = 0x01,   /* <u8 index> into the constant pool */
     T_STR = 0x02,   /* <u8 n> <n bytes> (0..7) */
     T_VAR = 0x03,   /* <u8 1..26> (A..Z) - numeric variable */
     T_VIDX = 0x04,  /* A(expr); expr follows, terminated by T_ENDX */
     T_SVAR = 0x05,  /* <u8 1..26> (A$..Z$) - string variable */
     T_SVIDX = 0x06, /* A$(expr); expr follows, terminated by T_ENDX */
+    T_NUM16 = 0x07, /* <u16 index> into the constant pool (index > 255) */
+    T_INT8 = 0x08,  /* <u8 value> - integer literal 0..255 */
+    T_INT16 = 0x09, /* <u16 value> - integer literal 256..65535 */
+    T_LAZY = 0x0A,  /* <u32 source offset> - stub of a line not tokenized yet, T_EOL padded */
     T_ENDX = 0xFF,  /* terminator for T_VIDX/T_SVIDX inline expression */
 
     /* Operators & punctuation */
@@ -87,16 +91,30 @@ enum
 {
     PROG_MAX_BYTES = 2048, /* Program storage (per clarifications) */
     LINES_MAX = 1024,      /* Maximum line records */
+    CONSTS_MAX = 512,      /* Numeric constant pool entries */
     VARS_MAX = 512,        /* A(n) range: 1..VARS_MAX (A..Z = 1..26) */
     STR_MAX = 7,           /* Maximum string length */
     GOSUB_MAX = 32,        /* GOSUB stack depth */
     FOR_MAX = 64,          /* FOR loop nesting depth */
-    EXPR_VAL_MAX = 64,     /* Expression evaluation stack */
     TOKBUF_LINE_MAX = 256, /* Maximum tokens per line */
     LINE_NUM_MAX = 999,    /* Maximum line number (1-999) */
     LABELS_MAX = 100       /* Maximum number of labels */
 };
 
+/* Extended mode limits (--extended): static capacity, the running limits are set at startup.
+ * The storage is static but only the pages a program actually uses are touched */
+enum
+{
+    PROG_EXT_MAX_BYTES = 4 * 1024 * 1024,  /* Program storage: 64K lines of 64 bytes */
+    LINES_EXT_MAX = 256 * 1024,            /* Maximum line records */
+    CONSTS_EXT_MAX = 65536,                /* Numeric constant pool entries (full T_NUM16 range) */
+    LINE_NUM_EXT_MAX = 0x7FFFFFFF,         /* Maximum line number (32 bit, fits an int) */
+    VARS_EXT_MAX = 1 << 28,                /* A(n) range: 1..VARS_EXT_MAX */
+    VAR_PAGE_CELLS = VARS_MAX,             /* Cells per sparse page, A(1..VARS_MAX) is the dense first page */
+    VAR_DIR_PAGES = VARS_EXT_MAX / VAR_PAGE_CELLS, /* Sparse page directory entries */
+    VAR_POOL_PAGES = 1024                  /* Sparse pages held in memory (512K cells, 4 MB) */
+};
+
 /* Error codes */
 typedef enum
 {
@@ -111,6 +129,7 @@ typedef enum
     ERR_FOR_STEP_ZERO = 6,
     ERR_RETURN_WITHOUT_GOSUB = 7,
     ERR_NEXT_WITHOUT_FOR = 8,
+    ERR_INPUT_END = 9, /* INPUT after the end of the input, with --input-eof error */
 
     /* Type 2 errors (structural) */
     ERR_TYPE2_BASE = 10,
@@ -0,0 +1,337 @@
+#include "output.h"
+#include "ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static uint32_t output_len;
+
+/* Asynchronous mode: full buffers are handed to a ring drained by a writer thread */
+static bool async_mode;
+static char output_ring[OUTPUT_RING_SIZE];
+static RingSync output_sync;
+static pthread_t writer_thread;
+
+static OutputSinkKind sink_kind;
+static int sink_fd;        /* OUTPUT_SINK_STDOUT and OUTPUT_SINK_FILE */
+static char *sink_memory;  /* OUTPUT_SINK_MEMORY: NUL terminated */
+static uint32_t sink_size; /* Including the NUL */
+static uint32_t sink_len;
+
+bool fd_write_all(int fd, const char *bytes, uint32_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, bytes, len);
+        if (written <= 0)
+            return false;
+        bytes += written;
+        len -= (uint32_t)written;
+    }
+    return true;
+}
+
+/* Append to the memory sink, dropping what does not fit */
+static void output_write_memory(const char *bytes, uint32_t len)
+{
+    uint32_t room = sink_size - 1 - sink_len;
+    if (len > room)
+        len = room;
+    memcpy(sink_memory + sink_len, bytes, len);
+    sink_len += len;
+    sink_memory[sink_len] = '\0';
+}
+
+/* Write bytes to the sink (the writer thread does it in asynchronous mode) */
+static void output_sink_write(const char *bytes, uint32_t len)
+{
+    switch (sink_kind)
+    {
+    case OUTPUT_SINK_STDOUT:
+    case OUTPUT_SINK_FILE:
+        fd_write_all(sink_fd, bytes, len); /* A failing sink drops the output */
+        break;
+    case OUTPUT_SINK_MEMORY:
+        output_write_memory(bytes, len);
+        break;
+    }
+}
+
+/* VM: append bytes to the ring, waiting only while it is full */
+static void output_ring_push(const char *bytes, uint32_t len)
+{
+    while (len > 0)
+    {
+        ring_wait_room(&output_sync, 1);
+        uint32_t offset = output_sync.head & (OUTPUT_RING_SIZE - 1);
+        uint32_t chunk = OUTPUT_RING_SIZE - offset; /* Up to the wrap */
+        if (chunk > ring_room(&output_sync))
+            chunk = ring_room(&output_sync);
+        if (chunk > len)
+            chunk = len;
+        memcpy(output_ring + offset, bytes, chunk);
+        ring_publish(&output_sync, chunk);
+        bytes += chunk;
+        len -= chunk;
+    }
+}
+
+/* Writer thread: write the ring out as it fills, in as few write() calls as the wrap allows */
+static void *output_writer(void *unused)
+{
+    (void)unused;
+    while (ring_wait_data(&output_sync))
+    {
+        uint32_t offset = output_sync.tail & (OUTPUT_RING_SIZE - 1);
+        uint32_t chunk = OUTPUT_RING_SIZE - offset;
+        if (chunk > ring_used(&output_sync))
+            chunk = ring_used(&output_sync);
+        output_sink_write(output_ring + offset, chunk);
+        ring_release(&output_sync, chunk);
+    }
+    return NULL;
+}
+
+/* Pass the buffered bytes on: to the ring, or straight to the sink */
+static void output_hand_over(void)
+{
+    /* Keep the order with the interpreter's own printf() messages */
+    if (sink_kind == OUTPUT_SINK_STDOUT)
+        fflush(stdout);
+    if (async_mode)
+        output_ring_push(output_buffer, output_len);
+    else
+        output_sink_write(output_buffer, output_len);
+    output_len = 0;
+}
+
+/* Leave the current sink, writing out what it is owed */
+static void output_leave_sink(void)
+{
+    output_flush();
+    if (sink_kind == OUTPUT_SINK_FILE)
+        close(sink_fd);
+}
+
+void output_init(void)
+{
+    output_len = 0;
+    sink_kind = OUTPUT_SINK_STDOUT;
+    sink_fd = STDOUT_FILENO;
+}
+
+bool output_open_file(const char *filename)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    output_leave_sink();
+    sink_kind = OUTPUT_SINK_FILE;
+    sink_fd = fd;
+    return true;
+}
+
+void output_set_memory(char *buffer, uint32_t size)
+{
+    assert(size > 0); /* Room for the NUL */
+
+    output_leave_sink();
+    sink_kind = OUTPUT_SINK_MEMORY;
+    sink_memory = buffer;
+    sink_size = size;
+    sink_len = 0;
+    sink_memory[0] = '\0';
+}
+
+bool output_start_writer(void)
+{
+    assert(!async_mode);
+    if (!ring_init(&output_sync, OUTPUT_RING_SIZE))
+        return false;
+    if (pthread_create(&writer_thread, NULL, output_writer, NULL) != 0)
+        return false;
+    /* The thread runs until the process exits, idle after each flush */
+    pthread_detach(writer_thread);
+    async_mode = true;
+    return true;
+}
+
+uint32_t output_memory_len(void)
+{
+    assert(sink_kind == OUTPUT_SINK_MEMORY);
+    return sink_len;
+}
+
+void output_char(char c)
+{
+    if (output_len == OUTPUT_BUFFER_SIZE)
+        output_hand_over();
+    output_buffer[output_len++] = c;
+}
+
+void output_bytes(const char *bytes, uint32_t len)
+{
+    while (len > 0)
+    {
+        if (output_len == OUTPUT_BUFFER_SIZE)
+            output_hand_over();
+        uint32_t chunk = OUTPUT_BUFFER_SIZE - output_len;
+        if (chunk > len)
+            chunk = len;
+        memcpy(output_buffer + output_len, bytes, chunk);
+        output_len += chunk;
+        bytes += chunk;
+        len -= chunk;
+    }
+}
+
+void output_str(const char *str)
+{
+    output_bytes(str, (uint32_t)strlen(str));
+}
+
+void output_number(double value)
+{
+    char text[NUMBER_TEXT_MAX];
+    output_bytes(text, number_format(value, text));
+}
+
+/* Write everything out, and in asynchronous mode wait until the writer has */
+void output_flush(void)
+{
+    output_hand_over();
+    if (async_mode)
+        ring_wait_room(&output_sync, OUTPUT_RING_SIZE);
+}
+
+/* Number formatting */
+
+enum
+{
+    MANTISSA_DIGITS = 10,
+    FIXED_EXP_MIN = -9, /* Decimal exponents shown in fixed point */
+    FIXED_EXP_MAX = 9
+};
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* value * 10^exp, exact powers of ten applied in as few steps as possible */
+double number_scale10(double value, int exp)
+{
+    for (; exp > 22; exp -= 22)
+        value *= 1e22;
+    for (; exp < -22; exp += 22)
+        value /= 1e22;
+    return exp >= 0 ? value * pow10_table[exp] : value / pow10_table[-exp];
+}
+
+/* Decimal digits of n, most significant first; returns their count */
+static int digits_of(uint64_t n, char digits[20])
+{
+    char reversed[20];
+    int len = 0;
+    do
+    {
+        reversed[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    for (int i = 0; i < len; i++)
+        digits[i] = reversed[len - 1 - i];
+    return len;
+}
+
+uint32_t number_format(double value, char text[NUMBER_TEXT_MAX])
+{
+    char *out = text;
+
+    if (!isfinite(value))
+        return (uint32_t)snprintf(text, NUMBER_TEXT_MAX, "%g", value);
+
+    if (value < 0)
+    {
+        *out++ = '-';
+        value = -value;
+    }
+
+    /* Integers of up to 10 digits print as they are */
+    if (value < 1e10 && value == (double)(uint64_t)value)
+    {
+        out += digits_of((uint64_t)value, out);
+        *out = '\0';
+        return (uint32_t)(out - text);
+    }
+
+    /* Round to a 10 digit mantissa: value = mantissa * 10^(exp - 9) */
+    int exp = (int)floor(log10(value));
+    uint64_t mantissa = (uint64_t)llround(number_scale10(value, MANTISSA_DIGITS - 1 - exp));
+    if (mantissa < 1000000000ULL) /* log10() rounded up */
+    {
+        exp--;
+        mantissa = (uint64_t)llround(number_scale10(value, MANTISSA_DIGITS - 1 - exp));
+    }
+    if (mantissa >= 10000000000ULL) /* log10() rounded down, or rounding carried */
+    {
+        exp++;
+        mantissa = (uint64_t)llround(number_scale10(value, MANTISSA_DIGITS - 1 - exp));
+    }
+    assert(1000000000ULL <= mantissa && mantissa < 10000000000ULL);
+
+    char digits[20];
+    int len = digits_of(mantissa, digits);
+    while (len > 1 && digits[len - 1] == '0')
+        len--;
+
+    if (FIXED_EXP_MIN <= exp && exp <= FIXED_EXP_MAX)
+    {
+        int point = exp + 1; /* Digits before the decimal point */
+        if (point <= 0)
+        {
+            *out++ = '0';
+            *out++ = '.';
+            for (int i = point; i < 0; i++)
+                *out++ = '0';
+            for (int i = 0; i < len; i++)
+                *out++ = digits[i];
+        }
+        else
+        {
+            for (int i = 0; i < len || i < point; i++)
+            {
+                if (i == point)
+                    *out++ = '.';
+                *out++ = i < len ? digits[i] : '0';
+            }
+        }
+    }
+    else
+    {
+        *out++ = digits[0];
+        if (len > 1)
+        {
+            *out++ = '.';
+            for (int i = 1; i < len; i++)
+                *out++ = digits[i];
+        }
+        /* The display shows a blank for a positive exponent sign */
+        *out++ = 'E';
+        *out++ = exp < 0 ? '-' : ' ';
+        char exp_digits[20];
+        int exp_len = digits_of((uint64_t)(exp < 0 ? -exp : exp), exp_digits);
+        if (exp_len < 2)
+            *out++ = '0';
+        for (int i = 0; i < exp_len; i++)
+            *out++ = exp_digits[i];
+    }
+
+    *out = '\0';
+    assert(out - text < NUMBER_TEXT_MAX);
+    return (uint32_t)(out - text);
+}
@@ -0,0 +1,53 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Program output (PRINT, PAUSE, BEEP, INPUT prompts) goes through a static
+ * buffer that is only written to its sink when full and at flush points:
+ * INPUT, PAUSE, and the end of the run. */
+
+enum
+{
+    OUTPUT_BUFFER_SIZE = 65536,
+    OUTPUT_RING_SIZE = 1 << 20, /* Asynchronous mode, a power of two */
+    NUMBER_TEXT_MAX = 32 /* number_format() text, NUL included */
+};
+
+typedef enum
+{
+    OUTPUT_SINK_STDOUT, /* Standard output, after anything stdio still holds */
+    OUTPUT_SINK_FILE,   /* File opened by output_open_file() */
+    OUTPUT_SINK_MEMORY  /* Caller's buffer, set by output_set_memory() */
+} OutputSinkKind;
+
+/* Sink selection (stdout after output_init) */
+void output_init(void);
+bool output_open_file(const char *filename);
+void output_set_memory(char *buffer, uint32_t size);
+uint32_t output_memory_len(void);
+
+/* Asynchronous mode: a writer thread does the sink writes, the VM only
+ * waits for it at flush points or when it falls a whole ring behind */
+bool output_start_writer(void);
+
+/* Buffered output */
+void output_char(char c);
+void output_bytes(const char *bytes, uint32_t len);
+void output_str(const char *str);
+void output_number(double value);
+void output_flush(void);
+
+/* Write all of bytes to a file descriptor, false on a write error */
+bool fd_write_all(int fd, const char *bytes, uint32_t len);
+
+/* PC-1211 display format: the value rounded to a 10 digit mantissa, without
+ * trailing zeros, in fixed point for 1E-9 <= |value| < 1E10 and as
+ * "1.234E 15" / "1.234E-15" otherwise. Returns the length written to text */
+uint32_t number_format(double value, char text[NUMBER_TEXT_MAX]);
+
+/* value * 10^exp, a single correctly rounded operation for |exp| <= 22 */
+double number_scale10(double value, int exp);
+
+#endif /* OUTPUT_H */
@@ -2,18 +2,120 @@
 #include "errors.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 /* Global program state */
 Program g_program;
 
-/* Initialize program memory */
+/* Constant pool lookup: open addressing on the value bits, slots hold index + 1 (0 is empty) */
+enum
+{
+    CONST_HASH_BITS = 17,
+    CONST_HASH_SIZE = 1 << CONST_HASH_BITS /* Twice CONSTS_EXT_MAX, so probes stay short */
+};
+static uint32_t const_hash[CONST_HASH_SIZE];
+
+/* Sparse A(n) pages when not file backed, and the value of cells on absent pages */
+static VarCell var_pool_ram[VAR_POOL_PAGES * VAR_PAGE_CELLS];
+static const VarCell var_zero_cell;
+
+/* Bulk loading: records are appended as they come, and only put in line order
+ * (through the scratch copy, touched only then) if one came in out of order */
+static bool load_unsorted;
+static uint8_t prog_scratch[PROG_EXT_MAX_BYTES];
+
+/* Streaming: lines still to come while the program runs (see program_set_more()) */
+static ProgramMoreFn program_more;
+
+/* Lazy loading: tokenizes the stubs (see program_set_lazy()). The room
+ * reserved by stubs, and the padding left after their tokens, does not count
+ * against prog_max: the program is as large as its tokens */
+static ProgramTokenizeFn program_tokenize;
+static int lazy_room;
+
+/* Bytes of each line header that count against prog_max: the PC-1211 keeps a
+ * 16 bit line number, so outside extended mode a header is charged as its 4.
+ * There a pooled constant is charged its 8 bytes too, as it would take them
+ * in the line that first uses it */
+static int line_hdr_charge;
+static int const_charge;
+
+/* Hash slot holding a constant, or the empty slot where it would go */
+static uint32_t *program_const_slot(double value)
+{
+    VarCell cell;
+    cell.num = value;
+    uint32_t slot = (uint32_t)((cell.bits * 0x9E3779B97F4A7C15ull) >> (64 - CONST_HASH_BITS));
+    for (;; slot = (slot + 1) & (CONST_HASH_SIZE - 1))
+    {
+        uint32_t entry = const_hash[slot];
+        if (entry == 0 || g_program.consts[entry - 1] == value)
+            return &const_hash[slot];
+    }
+}
+
+/* Initialize program memory with the authentic PC-1211 limits.
+ * The storage itself is static and already zero: only the used part is ever cleared */
 void program_init(void)
 {
-    memset(&g_program, 0, sizeof(g_program));
+    g_program.prog_max = PROG_MAX_BYTES;
+    g_program.lines_max = LINES_MAX;
+    g_program.line_num_max = LINE_NUM_MAX;
+    g_program.consts_max = CONSTS_MAX;
+    g_program.vars_max = VARS_MAX;
+    g_program.var_pool = var_pool_ram;
+    g_program.var_pool_max = VAR_POOL_PAGES;
+    line_hdr_charge = LINE_HDR_AUTHENTIC_LEN;
+    const_charge = sizeof(double);
     program_clear();
 }
 
+/* Switch to extended mode limits, before any line is loaded */
+void program_set_extended(int prog_max, int lines_max)
+{
+    assert(g_program.lines_len == 0);
+    assert(0 < prog_max && prog_max <= PROG_EXT_MAX_BYTES);
+    assert(0 < lines_max && lines_max <= LINES_EXT_MAX);
+    g_program.prog_max = prog_max;
+    g_program.lines_max = lines_max;
+    g_program.line_num_max = LINE_NUM_EXT_MAX;
+    g_program.consts_max = CONSTS_EXT_MAX;
+    g_program.vars_max = VARS_EXT_MAX;
+    line_hdr_charge = LINE_HDR_LEN;
+    const_charge = 0;
+}
+
+/* Bytes of the program that count against prog_max */
+int program_size(void)
+{
+    return g_program.prog_len - lazy_room - g_program.lines_len * (LINE_HDR_LEN - line_hdr_charge) +
+           g_program.consts_len * const_charge;
+}
+
+/* Whether the program still fits after growing by bytes, charged of them against prog_max, and lines */
+static bool program_fits(int bytes, int charged, int lines)
+{
+    return program_size() + charged <= g_program.prog_max && g_program.prog_len + bytes <= PROG_EXT_MAX_BYTES &&
+           g_program.lines_len + lines <= g_program.lines_max;
+}
+
+/* Whether one more line of token_len token bytes fits, room of them reserved by a stub */
+bool program_record_fits(int token_len, int room)
+{
+    return program_fits(LINE_HDR_LEN + token_len + 1, line_hdr_charge + token_len + 1 - room, 1);
+}
+
+/* Whether count more constants fit the pool and the program */
+bool program_consts_fit(int count)
+{
+    return g_program.consts_len + count <= g_program.consts_max &&
+           program_size() + count * const_charge <= g_program.prog_max;
+}
+
 /* Clear program memory */
 void program_clear(void)
 {
@@ -22,17 +124,91 @@ void program_clear(void)
     g_program.prog[1] = 0;
     g_program.prog[2] = 0xff;
     g_program.prog[3] = 0xff;
+    g_program.line_index[0] = 0; /* Terminator */
+    g_program.lines_len = 0;
+    load_unsorted = false;
+    lazy_room = 0;
+    program_set_unanalyzed();
+    for (int i = 0; i < g_program.consts_len; i++)
+    {
+        *program_const_slot(g_program.consts[i]) = 0;
+    }
+    g_program.consts_len = 0;
     var_init_all();
 }
 
-/* Initialize all variables to NUM=0, STR="" */
+/* Forget the stack bounds of the load-time analysis (the program changed) */
+void program_set_unanalyzed(void)
+{
+    g_program.call_depth = -1;
+    g_program.for_depth = -1;
+    g_program.expr_depth = -1;
+}
+
+/* Initialize all variables to NUM=0 (an all-zero cell is the number 0.0).
+ * Sparse pages stay in the directory, zeroed */
 void var_init_all(void)
 {
-    for (int i = 1; i <= VARS_MAX; i++)
+    memset(g_program.vars, 0, sizeof(g_program.vars));
+    memset(g_program.var_pool, 0, (size_t)g_program.var_pool_len * VAR_PAGE_CELLS * sizeof(VarCell));
+}
+
+/* Back the sparse pages with a shared file mapping, so A(n) can outgrow memory.
+ * The file is sized for the whole directory by writing its last byte, which
+ * leaves it sparse: only stored pages use disk */
+bool var_map_file(const char *path)
+{
+    assert(g_program.var_pool_len == 0);
+
+    size_t size = (size_t)VAR_DIR_PAGES * VAR_PAGE_CELLS * sizeof(VarCell);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    void *map = MAP_FAILED;
+    if (lseek(fd, (off_t)size - 1, SEEK_SET) == (off_t)size - 1 && write(fd, "", 1) == 1)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    g_program.var_pool = map;
+    g_program.var_pool_max = VAR_DIR_PAGES;
+    return true;
+}
+
+/* Directory entry of the sparse page holding A(index) */
+static uint32_t *var_page_slot(int index)
+{
+    assert(VARS_MAX < index && index <= g_program.vars_max);
+    return &g_program.var_pages[(index - 1) / VAR_PAGE_CELLS];
+}
+
+/* Cell of A(index) in the pool page of a directory entry */
+static VarCell *var_page_cell(uint32_t slot, int index)
+{
+    assert(0 < slot && slot <= (uint32_t)g_program.var_pool_len);
+    return g_program.var_pool + (size_t)(slot - 1) * VAR_PAGE_CELLS + (index - 1) % VAR_PAGE_CELLS;
+}
+
+/* Read a sparse cell - pages are only created by stores */
+const VarCell *var_sparse_load(int index)
+{
+    uint32_t slot = *var_page_slot(index);
+    return slot ? var_page_cell(slot, index) : &var_zero_cell;
+}
+
+/* Write a sparse cell, taking the next zeroed pool page on first store */
+VarCell *var_sparse_store(int index)
+{
+    uint32_t *slot = var_page_slot(index);
+    if (*slot == 0)
     {
-        g_program.vars[i].type = VAR_NUM;
-        g_program.vars[i].value.num = 0.0;
+        if (g_program.var_pool_len >= g_program.var_pool_max)
+            return NULL;
+        *slot = ++g_program.var_pool_len;
     }
+    return var_page_cell(*slot, index);
 }
 
 /* Get variable by 1-based index */
@@ -46,103 +222,343 @@ VarCell *var_get(int index)
     return &g_program.vars[index - 1];
 }
 
-/* Set variable to numeric value */
-void var_set_num(int index, double value)
+/* Store a number in a cell - caller has checked var_num_storable() */
+void var_cell_set_num(VarCell *cell, double value)
 {
-    VarCell *cell = var_get(index);
-    cell->type = VAR_NUM;
-    cell->value.num = value;
+    assert(var_num_storable(value));
+    cell->num = value;
 }
 
-/* Set variable to string value (truncate to STR_MAX, uppercase) */
-void var_set_str(int index, const char *value)
+/* Build a string word (truncate to STR_MAX, uppercase) */
+StrWord str_word_make(const char *str, int len)
 {
-    VarCell *cell = var_get(index);
-    cell->type = VAR_STR;
-
-    int len = strlen(value);
     if (len > STR_MAX)
     {
         len = STR_MAX;
     }
 
-    /* Copy and convert to uppercase */
+    StrWord word = 0;
     for (int i = 0; i < len; i++)
     {
-        char c = value[i];
+        char c = str[i];
         if (c >= 'a' && c <= 'z')
         {
             c = c - 'a' + 'A';
         }
-        cell->value.str[i] = c;
+        assert(c != '\0'); /* Zero bytes are padding */
+        word |= (StrWord)(uint8_t)c << (8 * i);
+    }
+    return word;
+}
+
+/* Copy a string word into str[STR_MAX + 1] as a C string, return its length */
+int str_word_get(StrWord word, char *str)
+{
+    int len = 0;
+    for (; len < STR_MAX && (word >> (8 * len)) & 0xFF; len++)
+    {
+        str[len] = (char)(word >> (8 * len));
+    }
+    str[len] = '\0';
+    return len;
+}
+
+/* Whether a value already has a slot in the pool */
+bool program_has_const(double value)
+{
+    return *program_const_slot(value) != 0;
+}
+
+/* Add a numeric constant to the pool, sharing the slot of an identical one */
+uint16_t program_add_const(double value)
+{
+    uint32_t *slot = program_const_slot(value);
+    if (*slot != 0)
+        return (uint16_t)(*slot - 1);
+
+    if (!program_consts_fit(1))
+    {
+        error_report(ERR_PROGRAM_TOO_LARGE, 0);
+        return 0; /* Never reached */
+    }
+
+    g_program.consts[g_program.consts_len] = value;
+    *slot = ++g_program.consts_len;
+    return (uint16_t)(g_program.consts_len - 1);
+}
+
+/* Size of a numeric literal token in bytes */
+int token_num_len(const uint8_t *token)
+{
+    assert(token_is_num(*token));
+    return (*token == T_NUM || *token == T_INT8) ? 1 + 1 : 1 + 2;
+}
+
+/* Value of a numeric literal token */
+double token_num_value(const uint8_t *token)
+{
+    switch (*token)
+    {
+    case T_INT8:
+        return token[1];
+    case T_INT16:
+        return get_u16(token + 1);
+    default:
+    {
+        assert(*token == T_NUM || *token == T_NUM16);
+        uint16_t index = (*token == T_NUM) ? token[1] : get_u16(token + 1);
+        assert(index < g_program.consts_len);
+        return g_program.consts[index];
+    }
+    }
+}
+
+/* Line record at a position of the line index (the terminator at lines_len) */
+uint8_t *program_line_at(int index)
+{
+    assert(0 <= index && index <= g_program.lines_len);
+    return g_program.prog + g_program.line_index[index];
+}
+
+/* Index of the first line numbered above line_num, or lines_len (binary search) */
+static int program_index_after(uint32_t line_num)
+{
+    int lo = 0;
+    int hi = g_program.lines_len;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (get_line(program_line_at(mid)) <= line_num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Index of line line_num, or -1 */
+int program_index_of(uint32_t line_num)
+{
+    int index = program_index_after(line_num) - 1;
+    return (index >= 0 && get_line(program_line_at(index)) == line_num) ? index : -1;
+}
+
+/* Move the index entries from..lines_len (last line records and terminator) to start at 'to',
+ * for records that moved by delta bytes */
+static void program_index_move(int from, int to, int delta)
+{
+    int count = g_program.lines_len + 1 - from;
+    memmove(&g_program.line_index[to], &g_program.line_index[from], count * sizeof(uint32_t));
+    for (int i = to; i < to + count; i++)
+    {
+        g_program.line_index[i] += delta;
     }
-    cell->value.str[len] = '\0';
 }
 
-/* Add or replace a line in program memory */
-bool program_add_line(uint16_t line_num, const uint8_t *tokens, int token_len)
+/* Write a line record's header, tokens and T_EOL at line_ptr */
+static void program_write_record(uint8_t *line_ptr, uint32_t line_num, const uint8_t *tokens, int token_len)
+{
+    *(uint16_t *)line_ptr = LINE_HDR_LEN + token_len + 1; /* len + line + tokens + T_EOL */
+    *(uint32_t *)(line_ptr + 2) = line_num;
+    memcpy(get_tokens(line_ptr), tokens, token_len);
+    line_ptr[LINE_HDR_LEN + token_len] = T_EOL;
+}
+
+/* Insert a line record before the one at a position of the line index (the
+ * terminator for an append, which only moves the terminator). The caller has
+ * checked the room */
+static void program_insert_record(int index, uint32_t line_num, const uint8_t *tokens, int token_len)
+{
+    int record_len = LINE_HDR_LEN + token_len + 1;
+    uint8_t *insert_pos = program_line_at(index);
+    int bytes_to_shift = g_program.prog + g_program.prog_len - insert_pos;
+    memmove(insert_pos + record_len, insert_pos, bytes_to_shift);
+    program_index_move(index, index + 1, record_len);
+    g_program.line_index[index] = insert_pos - g_program.prog;
+    g_program.lines_len++;
+    program_write_record(insert_pos, line_num, tokens, token_len);
+    g_program.prog_len += record_len;
+}
+
+/* Replace the tokens of the line at a position of the line index, moving the
+ * records after it by the difference. The caller has checked the room */
+static void program_replace_record(int index, const uint8_t *tokens, int token_len)
 {
-    if (line_num < 1 || line_num > LINE_NUM_MAX)
+    uint8_t *line_ptr = program_line_at(index);
+    assert(!program_is_lazy(line_ptr));
+    int delta = token_len - get_tokens_len(line_ptr);
+    uint8_t *after = line_ptr + get_len(line_ptr);
+    memmove(after + delta, after, g_program.prog + g_program.prog_len - after);
+    program_index_move(index + 1, index + 1, delta);
+    program_write_record(line_ptr, get_line(line_ptr), tokens, token_len);
+    g_program.prog_len += delta;
+}
+
+/* Add or replace a line in program memory. A line out of order moves the
+ * records after it: only appending in line order is O(log n) (see
+ * program_load_line() for loading a file in any order). A replaced line
+ * stays as it was if its new tokens do not fit */
+bool program_add_line(uint32_t line_num, const uint8_t *tokens, int token_len)
+{
+    if (line_num < 1 || line_num > g_program.line_num_max)
     {
         error_report(ERR_BAD_LINE_NUMBER, 0);
         return false;
     }
 
-    /* Calculate total record size */
-    int record_len = 4 + token_len + 1; /* len + line + tokens + T_EOL */
-
-    /* Check if program would be too large */
-    if (g_program.prog_len + record_len > PROG_MAX_BYTES)
+    int index = program_index_of(line_num);
+    int growth = index < 0 ? 0 : token_len - get_tokens_len(program_line_at(index));
+    if (index < 0 ? !program_record_fits(token_len, 0) : !program_fits(growth, growth, 0))
     {
         error_report(ERR_PROGRAM_TOO_LARGE, line_num);
         return false;
     }
 
-    /* Remove existing line if present */
-    program_delete_line(line_num);
+    if (index < 0)
+        program_insert_record(program_index_after(line_num), line_num, tokens, token_len);
+    else
+        program_replace_record(index, tokens, token_len);
+    program_set_unanalyzed();
+    return true;
+}
 
-    /* Find insertion point (maintain line number order) */
-    uint8_t *insert_pos = program_find_first_line_after(line_num);
-    int bytes_to_shift = g_program.prog + g_program.prog_len - insert_pos;
-    if (bytes_to_shift > 0)
+/* Bulk loading: line records put in order by the previous one */
+static int program_compare_records(const void *a, const void *b)
+{
+    uint32_t offset_a = *(const uint32_t *)a;
+    uint32_t offset_b = *(const uint32_t *)b;
+    uint32_t line_a = get_line(g_program.prog + offset_a);
+    uint32_t line_b = get_line(g_program.prog + offset_b);
+    if (line_a != line_b)
+        return line_a < line_b ? -1 : 1;
+    return offset_a < offset_b ? -1 : offset_a > offset_b; /* Arrival order */
+}
+
+/* Put the appended records in line order, keeping the last one loaded of each number */
+static void program_sort_records(void)
+{
+    int lines_len = g_program.lines_len;
+    qsort(g_program.line_index, lines_len, sizeof(uint32_t), program_compare_records);
+
+    uint32_t len = 0;
+    int kept = 0;
+    lazy_room = 0;
+    for (int i = 0; i < lines_len; i++)
     {
-        memmove(insert_pos + record_len, insert_pos, bytes_to_shift);
+        uint8_t *line_ptr = program_line_at(i);
+        if (i + 1 < lines_len && get_line(program_line_at(i + 1)) == get_line(line_ptr))
+            continue; /* Replaced by a later one */
+        if (program_is_lazy(line_ptr))
+            lazy_room += get_tokens_len(line_ptr);
+        memcpy(prog_scratch + len, line_ptr, get_len(line_ptr));
+        g_program.line_index[kept++] = len;
+        len += get_len(line_ptr);
     }
+    prog_scratch[len] = 0; /* Terminator */
+    prog_scratch[len + 1] = 0;
+    g_program.line_index[kept] = len;
+
+    memcpy(g_program.prog, prog_scratch, len + 2);
+    g_program.prog_len = (int)len + 2;
+    g_program.lines_len = kept;
+    load_unsorted = false;
+}
 
-    /* Write new record */
-    *(uint16_t *)insert_pos = record_len;
-    *(uint16_t *)(insert_pos + 2) = line_num;
-    memcpy(insert_pos + 4, tokens, token_len);
-    insert_pos[4 + token_len] = T_EOL;
-    g_program.prog_len += record_len;
+/* Append a record while loading, room of its token bytes reserved by a stub */
+static bool program_load_record(uint32_t line_num, const uint8_t *tokens, int token_len, int room)
+{
+    if (line_num < 1 || line_num > g_program.line_num_max)
+    {
+        error_report(ERR_BAD_LINE_NUMBER, 0);
+        return false;
+    }
+
+    if (g_program.lines_len > 0 && line_num <= get_line(program_line_at(g_program.lines_len - 1)))
+        load_unsorted = true;
+
+    if (load_unsorted && !program_record_fits(token_len, room))
+        program_sort_records();
+    if (!program_record_fits(token_len, room))
+    {
+        error_report(ERR_PROGRAM_TOO_LARGE, line_num);
+        return false;
+    }
 
-    // printf("PROGRAM ADD LINE %d (len=%d), new prog_len=%d\n", line_num, record_len, g_program.prog_len + record_len); // Debug print --- IGNORE ---
+    program_insert_record(g_program.lines_len, line_num, tokens, token_len);
+    lazy_room += room;
     return true;
 }
 
-void program_delete_line_ptr(uint8_t *line_ptr)
+/* Add a line while loading a file: appended in O(1) whatever its number, the
+ * order is restored by program_load_finish(). Replacing a line is deferred too,
+ * so running out of room sorts first to drop the replaced records */
+bool program_load_line(uint32_t line_num, const uint8_t *tokens, int token_len)
 {
-    assert(line_ptr);
-    size_t bytes_to_delete = get_len(line_ptr);
-    assert(bytes_to_delete > 0); /* Can't delete terminator */
-    size_t bytes_after = g_program.prog_len - (line_ptr - g_program.prog) - bytes_to_delete;
+    return program_load_record(line_num, tokens, token_len, 0);
+}
+
+bool program_load_stub(uint32_t line_num, const uint8_t *stub, int room)
+{
+    assert(*stub == T_LAZY);
+    return program_load_record(line_num, stub, room, room);
+}
+
+/* End of a file load: put its lines in order if they did not come that way */
+void program_load_finish(void)
+{
+    if (load_unsorted)
+        program_sort_records();
+    program_set_unanalyzed();
+}
+
+/* Replace the program with saved line records, line index and constant pool
+ * (see image.c). They must fit the limits in force */
+void program_restore(const uint8_t *prog, int prog_len, const uint32_t *line_index, int lines_len,
+                     const double *consts, int consts_len)
+{
+    assert(2 <= prog_len && prog_len <= PROG_EXT_MAX_BYTES);
+    assert(0 <= lines_len && lines_len <= g_program.lines_max);
+    assert(0 <= consts_len && consts_len <= g_program.consts_max);
 
-    if (bytes_after > 0)
+    program_clear();
+    memcpy(g_program.prog, prog, prog_len);
+    g_program.prog_len = prog_len;
+    memcpy(g_program.line_index, line_index, (lines_len + 1) * sizeof(uint32_t));
+    g_program.lines_len = lines_len;
+    for (int i = 0; i < consts_len; i++)
     {
-        memmove(line_ptr, line_ptr + bytes_to_delete, bytes_after);
+        g_program.consts[i] = consts[i];
+        uint32_t *slot = program_const_slot(consts[i]);
+        if (*slot == 0)
+            *slot = i + 1;
     }
+    g_program.consts_len = consts_len;
+}
+
+/* Delete the line at a position of the line index */
+static void program_delete_line_at(int index)
+{
+    uint8_t *line_ptr = program_line_at(index);
+    int bytes_to_delete = get_len(line_ptr);
+    assert(bytes_to_delete > 0); /* Can't delete terminator */
+    int bytes_after = g_program.prog_len - (line_ptr - g_program.prog) - bytes_to_delete;
+
+    memmove(line_ptr, line_ptr + bytes_to_delete, bytes_after);
+    program_index_move(index + 1, index, -bytes_to_delete);
+    g_program.lines_len--;
+    program_set_unanalyzed();
 
     g_program.prog_len -= bytes_to_delete;
 }
 
 /* Delete a line from program memory */
-bool program_delete_line(uint16_t line_num)
+bool program_delete_line(uint32_t line_num)
 {
-    uint8_t *line_ptr = program_find_line(line_num);
+    int index = program_index_of(line_num);
 
-    if (line_ptr)
+    if (index >= 0)
     {
-        program_delete_line_ptr(line_ptr);
+        program_delete_line_at(index);
         return true;
     }
 
@@ -150,7 +566,7 @@ bool program_delete_line(uint16_t line_num)
 }
 
 /* Label management functions */
-static bool program_match_label(uint8_t *line_ptr, const char *label)
+static bool program_match_label(uint8_t *line_ptr, StrWord label)
 {
     program_validate_line_ptr(line_ptr);
 
@@ -160,46 +576,66 @@ static bool program_match_label(uint8_t *line_ptr, const char *label)
         return false;
     uint8_t len = tokens[1];
 
-    return strncmp((const char *)(tokens + 2), label, len) == 0;
+    return str_word_make((const char *)(tokens + 2), len) == label;
 }
 
-/* Find line number for a label */
-uint8_t *program_find_line_label(const char *label)
+/* Find line number for a label. While streaming, lines loaded later are
+ * searched as they come: they go where the terminator was */
+uint8_t *program_find_line_label(StrWord label)
 {
-    for (uint8_t *line_ptr = program_first_line(); !program_is_last_line(line_ptr); line_ptr += get_len(line_ptr))
+    uint8_t *line_ptr = program_first_line();
+    do
     {
-        if (program_match_label(line_ptr, label))
-            return line_ptr;
-    }
+        for (; !program_is_last_line(line_ptr); line_ptr += get_len(line_ptr))
+        {
+            if (program_match_label(line_ptr, label))
+                return line_ptr;
+        }
+    } while (program_load_more());
     return NULL;
 }
 
-/* Find a line by line number */
-uint8_t *program_find_line(uint16_t target_line)
+/* Find a line by line number. While streaming, a line numbered above the
+ * last one loaded may still come: wait for it */
+uint8_t *program_find_line(uint32_t target_line)
 {
-    uint8_t *pos = g_program.prog;
-    while (get_len(pos) != 0)
+    int index = program_index_of(target_line);
+    while (index < 0 &&
+           (g_program.lines_len == 0 || get_line(program_line_at(g_program.lines_len - 1)) < target_line) &&
+           program_load_more())
     {
-        if (get_line(pos) == target_line)
-            return pos;
-        pos += get_len(pos);
+        index = program_index_of(target_line);
     }
-    return NULL;
+    return index >= 0 ? program_line_at(index) : NULL;
 }
 
-/* Find the last line before a given line number */
-uint8_t *program_find_first_line_after(uint16_t target_line)
+/* Find the first line after a given line number */
+uint8_t *program_find_first_line_after(uint32_t target_line)
 {
-    uint8_t *pos = g_program.prog;
+    return program_line_at(program_index_after(target_line)); /* End marker if no later line */
+}
+
+/* Find the line record that contains a token pointer (binary search on record offsets) */
+uint8_t *program_find_line_containing(uint8_t *token_ptr)
+{
+    assert(program_validate_token_ptr(token_ptr));
 
-    while (get_len(pos) != 0)
+    uint32_t offset = token_ptr - g_program.prog;
+    assert(offset < g_program.line_index[g_program.lines_len]); /* Token pointer is past the last line */
+
+    /* Find the first record starting after the token, the one before contains it */
+    int lo = 0;
+    int hi = g_program.lines_len;
+    while (lo < hi)
     {
-        if (get_line(pos) > target_line)
-            return pos;
-        pos += get_len(pos);
+        int mid = lo + (hi - lo) / 2;
+        if (g_program.line_index[mid] <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-
-    return pos; /* Return end marker if no later line found */
+    assert(lo > 0);
+    return program_line_at(lo - 1);
 }
 
 /* Get first line */
@@ -236,8 +672,8 @@ void program_validate_line_ptr(uint8_t *line_ptr)
     /* Line must fit within program bounds */
     assert(line_ptr + len <= g_program.prog + g_program.prog_len);
 
-    /* Minimum line size: len(2) + line_num(2) + T_EOL(1) = 5 bytes */
-    assert(len >= 5);
+    /* Minimum line size: len(2) + line_num(4) + T_EOL(1) = 7 bytes */
+    assert(len >= LINE_HDR_LEN + 1);
 }
 
 /* Check if we're at the last line (for iteration) */
@@ -247,6 +683,56 @@ bool program_is_last_line(uint8_t *line_ptr)
     return get_len(line_ptr) == 0;
 }
 
+/* Streaming */
+void program_set_more(ProgramMoreFn more)
+{
+    program_more = more;
+}
+
+bool program_load_more(void)
+{
+    return program_more != NULL && program_more();
+}
+
+/* Lazy loading */
+void program_set_lazy(ProgramTokenizeFn tokenize)
+{
+    program_tokenize = tokenize;
+}
+
+void program_tokenize_lazy(uint8_t *line_ptr)
+{
+    assert(program_tokenize && program_is_lazy(line_ptr));
+    program_tokenize(line_ptr);
+    assert(!program_is_lazy(line_ptr));
+}
+
+/* Write a lazy line's tokens over its stub; T_EOL pads the rest of the room */
+bool program_fill_line(uint8_t *line_ptr, const uint8_t *tokens, int token_len)
+{
+    assert(program_is_lazy(line_ptr));
+    assert(0 <= token_len && token_len <= get_tokens_len(line_ptr));
+    if (program_size() + token_len > g_program.prog_max)
+        return false;
+    lazy_room -= token_len;
+    memcpy(get_tokens(line_ptr), tokens, token_len);
+    memset(get_tokens(line_ptr) + token_len, T_EOL, get_tokens_len(line_ptr) + 1 - token_len);
+    return true;
+}
+
+/* Whether a line record is the end of the program for good: the terminator,
+ * and no more lines to come. A streamed line is appended where the
+ * terminator was, so line_ptr is then the first of the new lines */
+bool program_at_end(uint8_t *line_ptr)
+{
+    while (program_is_last_line(line_ptr))
+    {
+        if (!program_load_more())
+            return true;
+    }
+    return false;
+}
+
 /* Get next line - NEVER call at end of program!
  * This function NEVER returns NULL - it either succeeds or asserts.
  * Use program_is_last_line() to check for end before calling. */
@@ -282,7 +768,10 @@ uint8_t *token_skip(uint8_t *token)
     switch (*token)
     {
     case T_NUM:
-        token += 1 + 8; /* opcode + 8 bytes double */
+    case T_NUM16:
+    case T_INT8:
+    case T_INT16:
+        token += token_num_len(token); /* opcode + constant pool index */
         break;
 
     case T_STR:
@@ -294,7 +783,6 @@ uint8_t *token_skip(uint8_t *token)
 
     case T_VAR:
     case T_SVAR:
-    case T_THEN:        /* THEN followed by u16 line number */
         token += 1 + 1; /* opcode + 1 byte data */
         break;
 
@@ -352,10 +840,13 @@ void token_dump(const uint8_t *tokens, int len)
         switch (*pos)
         {
         case T_NUM:
+        case T_NUM16:
+        case T_INT8:
+        case T_INT16:
         {
-            double val = *(double *)(pos + 1);
+            double val = token_num_value(pos);
             printf(" (NUM: %g)", val);
-            pos += 9;
+            pos += token_num_len(pos);
             break;
         }
 
@@ -400,7 +891,7 @@ void token_dump(const uint8_t *tokens, int len)
 /* VM helper functions */
 
 /* Get token start for line */
-uint8_t *program_find_line_tokens(uint16_t line_num)
+uint8_t *program_find_line_tokens(uint32_t line_num)
 {
     uint8_t *line_ptr = program_find_line(line_num);
     return line_ptr ? get_tokens(line_ptr) : NULL;
@@ -459,17 +950,17 @@ uint8_t *program_next_line_tokens(uint8_t *current)
 
     while (pos < prog_end)
     {
-        uint16_t len = *(uint16_t *)pos;
-        uint8_t *tokens = pos + 4;
+        uint16_t len = get_len(pos);
+        uint8_t *tokens = get_tokens(pos);
 
-        if (tokens <= current && current < tokens + len - 4)
+        if (tokens <= current && current < pos + len)
         {
             /* Found current line, get next */
             pos += len;
             if (pos >= prog_end)
                 return NULL;
 
-            return pos + 4; /* Skip header of next line */
+            return get_tokens(pos); /* Skip header of next line */
         }
 
         pos += len;
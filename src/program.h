@@ -5,22 +5,37 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-/* Variable cell - can hold either number or string */
-typedef enum
+/* Variable cell - 8 bytes holding either a number or a string, as on the PC-1211.
+ * A string cell has VAR_STR_TAG in its top byte and up to STR_MAX characters,
+ * zero padded, in the low bytes (character i in bits 8*i..8*i+7).
+ * Any other bit pattern is a double. The only doubles with that top byte are
+ * below -5E303, -inf or a negative NaN, far outside the PC-1211 range: the VM
+ * reports them as overflow instead of storing them (see var_num_storable()). */
+typedef union
 {
-    VAR_NUM,
-    VAR_STR
-} VarType;
+    double num;    /* Numeric value */
+    uint64_t bits; /* Raw cell (string tag and characters) */
+} VarCell;
 
-typedef struct
+enum
 {
-    VarType type;
-    union
-    {
-        double num;
-        char str[STR_MAX + 1]; /* +1 for null terminator */
-    } value;
-} VarCell;
+    VAR_STR_TAG = 0xFF /* Top byte of a string cell */
+};
+
+/* String value - up to STR_MAX characters, zero padded, character i in bits 8*i..8*i+7.
+ * Equal strings have equal words: comparing or copying a string is one integer operation. */
+typedef uint64_t StrWord;
+#define STR_WORD_MASK 0x00FFFFFFFFFFFFFFull /* Bits used by STR_MAX characters */
+
+static inline bool var_is_str(const VarCell *cell) { return (cell->bits >> 56) == VAR_STR_TAG; }
+static inline StrWord var_cell_get_word(const VarCell *cell) { return var_is_str(cell) ? cell->bits & STR_WORD_MASK : 0; }
+static inline void var_cell_set_word(VarCell *cell, StrWord word) { cell->bits = word | ((uint64_t)VAR_STR_TAG << 56); }
+static inline bool var_num_storable(double value)
+{
+    VarCell cell;
+    cell.num = value;
+    return !var_is_str(&cell);
+}
 
 /* Label table entry */
 typedef struct
@@ -29,21 +44,48 @@ typedef struct
     uint16_t line_num;       /* Line number where label is defined */
 } LabelEntry;
 
-/* Program memory structure */
+/* Program memory structure.
+ * Storage is sized for extended mode; the *_max fields hold the limits in force,
+ * which are the authentic PC-1211 ones unless program_set_extended() was called */
 typedef struct
 {
-    uint8_t prog[PROG_MAX_BYTES]; /* Token buffer */
-    int prog_len;                 /* Current program size */
-    VarCell vars[VARS_MAX + 1];   /* Variables 1..VARS_MAX (0 unused) */
+    uint8_t prog[PROG_EXT_MAX_BYTES];       /* Token buffer */
+    int prog_len;                           /* Current program size */
+    int prog_max;                           /* Program size limit */
+    uint32_t line_index[LINES_EXT_MAX + 1]; /* Offset of each line record in line order, then of the terminator */
+    int lines_len;                          /* Number of lines */
+    int lines_max;                          /* Line count limit */
+    uint32_t line_num_max;                  /* Highest line number */
+    double consts[CONSTS_EXT_MAX];          /* Numeric constant pool (aligned, deduplicated) */
+    int consts_len;                         /* Number of constants in the pool */
+    int consts_max;                         /* Constant pool limit */
+    VarCell vars[VARS_MAX + 1];             /* Variables 1..VARS_MAX (0 unused) */
+    int vars_max;                           /* A(n) limit */
+    uint32_t var_pages[VAR_DIR_PAGES];      /* Sparse page directory: pool page + 1, 0 if never stored */
+    VarCell *var_pool;                      /* Sparse pages, VAR_PAGE_CELLS cells each */
+    int var_pool_len;                       /* Sparse pages in use */
+    int var_pool_max;                       /* Sparse pages available */
+    int call_depth;                         /* GOSUB depth proven at load time, -1 if unknown */
+    int for_depth;                          /* FOR depth proven at load time, -1 if unknown */
+    int expr_depth;                         /* Deepest expression nesting, -1 if not analyzed */
 } Program;
 
-/* Line record format: u16 len | u16 line | tokens... | T_EOL */
+/* Line record format: u16 len | u32 line | tokens... | T_EOL */
 /* Lines are accessed via uint8_t* pointers to the start of the record */
+enum
+{
+    LINE_HDR_LEN = 6,          /* len + line */
+    LINE_HDR_AUTHENTIC_LEN = 4 /* len + 16 bit line, as charged outside extended mode */
+};
 
 /* Helper functions to access line record fields */
 static inline uint16_t get_len(uint8_t *line_ptr) { return *(uint16_t *)line_ptr; }
-static inline uint16_t get_line(uint8_t *line_ptr) { return *(uint16_t *)(line_ptr + 2); }
-static inline uint8_t *get_tokens(uint8_t *line_ptr) { return line_ptr + 4; }
+static inline uint32_t get_line(uint8_t *line_ptr) { return *(uint32_t *)(line_ptr + 2); }
+static inline uint8_t *get_tokens(uint8_t *line_ptr) { return line_ptr + LINE_HDR_LEN; }
+static inline int get_tokens_len(uint8_t *line_ptr) { return get_len(line_ptr) - LINE_HDR_LEN - 1; } /* Without T_EOL */
+
+/* Token immediates are stored byte by byte (little endian), never read through a cast */
+static inline uint16_t get_u16(const uint8_t *ptr) { return (uint16_t)(ptr[0] | (ptr[1] << 8)); }
 
 /* Global program state */
 extern Program g_program;
@@ -51,16 +93,55 @@ extern Program g_program;
 /* Program management */
 void program_init(void);
 void program_clear(void);
+void program_set_extended(int prog_max, int lines_max); /* Raise limits, before loading */
+void program_set_unanalyzed(void);                      /* Drop the proven stack bounds */
+int program_size(void);                                 /* Bytes counted against prog_max */
+bool program_record_fits(int token_len, int room);      /* Room for one more line */
+bool program_consts_fit(int count);                     /* Room for count more constants */
 
 /* Line management */
-bool program_add_line(uint16_t line_num, const uint8_t *tokens, int token_len);
-bool program_delete_line(uint16_t line_num);
+bool program_add_line(uint32_t line_num, const uint8_t *tokens, int token_len);
+bool program_delete_line(uint32_t line_num);
+
+/* Bulk loading: program_load_line() appends in any order, program_load_finish()
+ * then puts the lines in order (the last one loaded of a number wins) */
+bool program_load_line(uint32_t line_num, const uint8_t *tokens, int token_len);
+void program_load_finish(void);
+
+/* Streaming: the program runs while the rest of its file loads. more()
+ * appends the lines loaded since the last call, waiting for at least one,
+ * and returns false once no more will come. Lookups of a line or label not
+ * loaded yet, and reaching the end of the loaded lines, call it. Lines are
+ * only ever appended, in increasing order: records never move */
+typedef bool (*ProgramMoreFn)(void);
+void program_set_more(ProgramMoreFn more); /* NULL: the program is complete */
+bool program_load_more(void);              /* false if nothing more will come */
+bool program_at_end(uint8_t *line_ptr);    /* The terminator, once nothing more will come */
+
+/* Lazy loading: a line may be loaded as a stub, T_LAZY and padding reserving
+ * room for its tokens. The first time the run enters it, tokenize() writes the
+ * tokens over the stub (program_fill_line()), or stops the run with the
+ * line's error. Records never move. Only tokens count against prog_max: a stub
+ * as an empty line, a line once tokenized, false then if it no longer fits */
+typedef void (*ProgramTokenizeFn)(uint8_t *line_ptr);
+void program_set_lazy(ProgramTokenizeFn tokenize);
+void program_tokenize_lazy(uint8_t *line_ptr);
+bool program_load_stub(uint32_t line_num, const uint8_t *stub, int room); /* Like program_load_line() */
+bool program_fill_line(uint8_t *line_ptr, const uint8_t *tokens, int token_len);
+static inline bool program_is_lazy(uint8_t *line_ptr) { return get_len(line_ptr) != 0 && *get_tokens(line_ptr) == T_LAZY; }
+
+/* Program images: replace the program with saved records, index and pool */
+void program_restore(const uint8_t *prog, int prog_len, const uint32_t *line_index, int lines_len,
+                     const double *consts, int consts_len);
 
 /* Label management */
 void program_add_label(const char *label, uint16_t line_num);
-uint8_t *program_find_line_label(const char *label);
-uint8_t *program_find_line(uint16_t line_num);
-uint8_t *program_find_first_line_after(uint16_t target_line);
+uint8_t *program_find_line_label(StrWord label);
+uint8_t *program_find_line(uint32_t line_num);
+uint8_t *program_line_at(int index);     /* Line record by position, the terminator at lines_len */
+int program_index_of(uint32_t line_num); /* Position of a line, -1 if absent */
+uint8_t *program_find_first_line_after(uint32_t target_line);
+uint8_t *program_find_line_containing(uint8_t *token_ptr);
 uint8_t *program_first_line(void);
 void program_validate_line_ptr(uint8_t *line_ptr);
 bool program_is_last_line(uint8_t *line_ptr);
@@ -69,8 +150,27 @@ uint8_t *program_next_line(uint8_t *current_line);
 /* Variable management */
 void var_init_all(void);
 VarCell *var_get(int index); /* 1-based indexing */
-void var_set_num(int index, double value);
-void var_set_str(int index, const char *value);
+void var_cell_set_num(VarCell *cell, double value);
+bool var_map_file(const char *path); /* Back sparse pages with a file, before running */
+
+/* A(n) cells, 1 <= index <= vars_max: dense up to VARS_MAX, then sparse pages (extended mode) */
+const VarCell *var_sparse_load(int index); /* Zero cell if the page was never stored to */
+VarCell *var_sparse_store(int index);      /* Creates the page, NULL if out of pages */
+static inline const VarCell *var_cell_load(int index) { return index <= VARS_MAX ? &g_program.vars[index - 1] : var_sparse_load(index); }
+static inline VarCell *var_cell_store(int index) { return index <= VARS_MAX ? &g_program.vars[index - 1] : var_sparse_store(index); }
+
+/* String words */
+StrWord str_word_make(const char *str, int len); /* Truncate to STR_MAX, uppercase */
+int str_word_get(StrWord word, char *str);        /* str[STR_MAX + 1], returns length */
+
+/* Numeric constant pool */
+uint16_t program_add_const(double value); /* Returns index, reuses an identical constant */
+bool program_has_const(double value);     /* Already in the pool */
+
+/* Numeric literal tokens (pool indexes and inline small integers) */
+static inline bool token_is_num(uint8_t token) { return token == T_NUM || token == T_NUM16 || token == T_INT8 || token == T_INT16; }
+int token_num_len(const uint8_t *token);      /* Size of a numeric literal token in bytes */
+double token_num_value(const uint8_t *token); /* Value of a numeric literal token */
 
 /* Token stream utilities */
 bool program_validate_token_ptr(uint8_t *token_ptr);
@@ -78,7 +178,7 @@ uint8_t *token_skip(uint8_t *token);             /* Skip one token, return next
 void token_dump(const uint8_t *tokens, int len); /* Debug dump */
 
 /* VM helper functions */
-uint8_t *program_find_line_tokens(uint16_t line_num);  /* Get token start for line */
+uint8_t *program_find_line_tokens(uint32_t line_num);  /* Get token start for line */
 uint8_t *program_find_line_end(uint8_t *tokens);       /* Find end of current line */
 uint8_t *program_find_line_end_from_pos(uint8_t *pos); /* Find end from any position within line */
 uint8_t *program_first_line_tokens(void);              /* Get first line tokens */
@@ -0,0 +1,132 @@
+#include "ring.h"
+#include <assert.h>
+
+static uint32_t ring_load(uint32_t *index)
+{
+    return __atomic_load_n(index, __ATOMIC_SEQ_CST);
+}
+
+static void ring_store(uint32_t *index, uint32_t value)
+{
+    __atomic_store_n(index, value, __ATOMIC_SEQ_CST);
+}
+
+static void ring_set_flag(int *flag, int value)
+{
+    __atomic_store_n(flag, value, __ATOMIC_SEQ_CST);
+}
+
+/* Signal a condition under the lock: a waiter is either asleep on it or has yet to re-check */
+static void ring_signal(RingSync *ring, pthread_cond_t *cond)
+{
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/* Signal data_ready if the consumer sleeps */
+static void ring_wake_consumer(RingSync *ring)
+{
+    if (__atomic_load_n(&ring->consumer_idle, __ATOMIC_SEQ_CST))
+        ring_signal(ring, &ring->data_ready);
+}
+
+bool ring_init(RingSync *ring, uint32_t size)
+{
+    assert(size > 0 && (size & (size - 1)) == 0);
+    ring->head = 0;
+    ring->tail = 0;
+    ring->size = size;
+    ring->consumer_idle = 0;
+    ring->room_wanted = 0;
+    ring->closed = 0;
+    if (pthread_mutex_init(&ring->lock, NULL) != 0)
+        return false;
+    if (pthread_cond_init(&ring->data_ready, NULL) != 0)
+    {
+        pthread_mutex_destroy(&ring->lock);
+        return false;
+    }
+    if (pthread_cond_init(&ring->space_ready, NULL) != 0)
+    {
+        pthread_cond_destroy(&ring->data_ready);
+        pthread_mutex_destroy(&ring->lock);
+        return false;
+    }
+    return true;
+}
+
+void ring_destroy(RingSync *ring)
+{
+    pthread_cond_destroy(&ring->space_ready);
+    pthread_cond_destroy(&ring->data_ready);
+    pthread_mutex_destroy(&ring->lock);
+}
+
+uint32_t ring_room(RingSync *ring)
+{
+    return ring->size - (ring->head - ring_load(&ring->tail));
+}
+
+void ring_wait_room(RingSync *ring, uint32_t room)
+{
+    assert(room <= ring->size);
+    while (ring_room(ring) < room)
+    {
+        pthread_mutex_lock(&ring->lock);
+        ring_store(&ring->room_wanted, room);
+        if (ring_room(ring) < room)
+            pthread_cond_wait(&ring->space_ready, &ring->lock);
+        ring_store(&ring->room_wanted, 0);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+void ring_publish(RingSync *ring, uint32_t count)
+{
+    assert(count <= ring_room(ring));
+    ring_store(&ring->head, ring->head + count);
+    ring_wake_consumer(ring);
+}
+
+void ring_close(RingSync *ring)
+{
+    ring_set_flag(&ring->closed, 1);
+    ring_wake_consumer(ring);
+}
+
+uint32_t ring_used(RingSync *ring)
+{
+    return ring_load(&ring->head) - ring->tail;
+}
+
+bool ring_wait_data(RingSync *ring)
+{
+    for (;;)
+    {
+        /* Closed is read first: data published before closing is seen below */
+        bool closed = __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+        if (ring_used(ring) > 0)
+            return true;
+        if (closed)
+            return false;
+
+        pthread_mutex_lock(&ring->lock);
+        ring_set_flag(&ring->consumer_idle, 1);
+        if (ring_used(ring) == 0 && !__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST))
+            pthread_cond_wait(&ring->data_ready, &ring->lock);
+        ring_set_flag(&ring->consumer_idle, 0);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+void ring_release(RingSync *ring, uint32_t count)
+{
+    assert(count <= ring_used(ring));
+    ring_store(&ring->tail, ring->tail + count);
+
+    /* Wake the producer only once it has the room it waits for */
+    uint32_t room_wanted = ring_load(&ring->room_wanted);
+    if (room_wanted && ring->size - (ring_load(&ring->head) - ring->tail) >= room_wanted)
+        ring_signal(ring, &ring->space_ready);
+}
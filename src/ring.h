@@ -0,0 +1,44 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Single producer / single consumer ring synchronisation, for the output
+ * writer and the input reader threads. The data lives with the caller, the
+ * ring only counts slots: head and tail only grow (wrapping modulo 2^32), the
+ * producer owns head, the consumer owns tail. A side that has to wait raises
+ * its flag (for the producer: the room it needs) under the lock, re-checks
+ * the other side's index, and sleeps on its condition; the other side
+ * signals it under the lock when it sees the flag satisfied. All accesses are
+ * sequentially consistent and the waiter holds the lock from its check until
+ * it sleeps, so a wake-up is never lost. */
+typedef struct
+{
+    uint32_t head;        /* Slots published by the producer */
+    uint32_t tail;        /* Slots released by the consumer */
+    uint32_t size;        /* Capacity, a power of two */
+    int consumer_idle;    /* The consumer waits for data_ready */
+    uint32_t room_wanted; /* The producer waits for space_ready until this much is free */
+    int closed;           /* The producer will publish nothing more */
+    pthread_mutex_t lock;
+    pthread_cond_t data_ready;
+    pthread_cond_t space_ready;
+} RingSync;
+
+bool ring_init(RingSync *ring, uint32_t size);
+void ring_destroy(RingSync *ring); /* Once neither side uses it */
+
+/* Producer side */
+uint32_t ring_room(RingSync *ring);
+void ring_wait_room(RingSync *ring, uint32_t room); /* size: wait until drained */
+void ring_publish(RingSync *ring, uint32_t count);
+void ring_close(RingSync *ring);
+
+/* Consumer side */
+uint32_t ring_used(RingSync *ring);
+bool ring_wait_data(RingSync *ring); /* false once closed and drained */
+void ring_release(RingSync *ring, uint32_t count);
+
+#endif /* RING_H */
@@ -1,83 +1,66 @@
 #include "tokenizer.h"
 #include "program.h"
 #include "errors.h"
+#include "keyword_hash.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdint.h>
+#if defined(__AVX2__) && !defined(LEX_SCALAR)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(LEX_SCALAR)
+#include <emmintrin.h>
+#endif
+
+enum
+{
+    KEYWORD_WORD_MAX = 32,   /* A word this long is a syntax error */
+    NUMBER_EXACT_DIGITS = 15 /* Integers with this many digits are exact doubles */
+};
 
 /* Forward declaration for recursive expression parsing */
 static bool tokenize_expression_recursive(Tokenizer *t, int *paren_count);
 
 /* Keyword table - full names and abbreviations */
 static const Keyword keywords[] = {
-    /* Functions */
-    {"SIN", "SI.", T_SIN},
-    {"COS", NULL, T_COS},
-    {"TAN", "TA.", T_TAN},
-    {"ASN", "AS.", T_ASN},
-    {"ACS", "AC.", T_ACS},
-    {"ATN", "AT.", T_ATN},
-    {"LOG", "LO.", T_LOG},
-    {"LN", NULL, T_LN},
-    {"EXP", "EX.", T_EXP},
-    {"SQR", NULL, T_SQR},
-    {"DMS", "DM.", T_DMS},
-    {"DEG", NULL, T_DEG},
-    {"INT", NULL, T_INT},
-    {"ABS", "AB.", T_ABS},
-    {"SGN", "SG.", T_SGN},
-
-    /* Statements */
-    {"LET", "LE.", T_LET},
-    {"PRINT", "P.", T_PRINT},
-    {"INPUT", "I.", T_INPUT},
-    {"IF", NULL, T_IF},
-    {"THEN", "T.", T_THEN},
-    {"GOTO", "G.", T_GOTO},
-    {"GOSUB", "GOS.", T_GOSUB},
-    {"RETURN", "RE.", T_RETURN},
-    {"FOR", "F.", T_FOR},
-    {"TO", NULL, T_TO},
-    {"STEP", "STE.", T_STEP},
-    {"NEXT", "N.", T_NEXT},
-    {"END", "E.", T_END},
-    {"STOP", "S.", T_STOP},
-    {"REM", NULL, T_REM},
-
-    /* Mode commands */
-    {"DEGREE", "DEG.", T_DEGREE},
-    {"RADIAN", "RA.", T_RADIAN},
-    {"GRAD", NULL, T_GRAD},
-    {"CLEAR", "CL.", T_CLEAR},
-    {"BEEP", "B.", T_BEEP},
-    {"PAUSE", "PA.", T_PAUSE},
-    {"AREAD", "A.", T_AREAD},
-    {"USING", "U.", T_USING},
-
+#define KEYWORD(name, abbrev, token) {name, abbrev, token},
+#include "keywords.def"
+#undef KEYWORD
     {NULL, NULL, 0} /* Terminator */
 };
 
+/* Find keyword by the word of len characters at word (case-insensitive):
+ * the perfect hash names the only spelling it can be, one compare settles it */
+static const Keyword *find_keyword_len(const char *word, int len)
+{
+    if (len == 0 || len > KEYWORD_LEN_MAX)
+        return NULL;
+
+    int entry = keyword_slots[keyword_hash(word, len)];
+    if (entry == 0)
+        return NULL;
+    const Keyword *kw = &keywords[(entry - 1) / 2];
+    const char *spelling = (entry - 1) % 2 ? kw->abbrev : kw->name;
+    if (strncasecmp(word, spelling, len) != 0 || spelling[len] != '\0')
+        return NULL;
+    return kw;
+}
+
 /* Find keyword by name (case-insensitive) */
 const Keyword *find_keyword(const char *word)
 {
-    for (const Keyword *kw = keywords; kw->name != NULL; kw++)
-    {
-        /* Check full name */
-        if (strcasecmp(word, kw->name) == 0)
-        {
-            return kw;
-        }
-        /* Check abbreviation */
-        if (kw->abbrev && strcasecmp(word, kw->abbrev) == 0)
-        {
-            return kw;
-        }
-    }
-    return NULL;
+    return find_keyword_len(word, (int)strlen(word));
 }
 
 /* Character classification */
+
+/* A line ends at its newline (source files are tokenized in place) or NUL */
+static inline bool is_line_end(char c)
+{
+    return c == '\0' || c == '\n';
+}
+
 bool is_alpha(char c)
 {
     return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
@@ -93,13 +76,129 @@ bool is_alnum(char c)
     return is_alpha(c) || is_digit(c);
 }
 
-/* Skip whitespace */
-void skip_whitespace(Tokenizer *t)
+/* Spans of one character class, found a vector at a time when the target has
+ * SSE2 or AVX2 (LEX_SCALAR forces the portable loop, for comparison).
+ * Vectors are loaded unaligned and only while a whole one lies before the
+ * line's end, so no byte outside the line is read; the last few characters
+ * are checked one at a time. The scan stops at the line's NUL or newline at
+ * the latest, as neither is in any class. */
+typedef enum
+{
+    LEX_BLANK, /* ' ', '\t' */
+    LEX_WORD,  /* Letters, digits and '.' (keywords and their abbreviations) */
+    LEX_DIGIT  /* '0'..'9' */
+} LexClass;
+
+#if defined(__AVX2__) && !defined(LEX_SCALAR)
+typedef __m256i LexVector;
+typedef uint32_t LexMask;
+enum
+{
+    LEX_WIDTH = 32
+};
+#define lex_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define lex_set(c) _mm256_set1_epi8(c)
+#define lex_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define lex_gt(a, b) _mm256_cmpgt_epi8(a, b)
+#define lex_and(a, b) _mm256_and_si256(a, b)
+#define lex_or(a, b) _mm256_or_si256(a, b)
+#define lex_bits(v) ((LexMask)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__) && !defined(LEX_SCALAR)
+typedef __m128i LexVector;
+typedef uint32_t LexMask;
+enum
+{
+    LEX_WIDTH = 16
+};
+#define lex_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define lex_set(c) _mm_set1_epi8(c)
+#define lex_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define lex_gt(a, b) _mm_cmpgt_epi8(a, b)
+#define lex_and(a, b) _mm_and_si128(a, b)
+#define lex_or(a, b) _mm_or_si128(a, b)
+#define lex_bits(v) ((LexMask)_mm_movemask_epi8(v))
+#endif
+
+static inline bool lex_in_class(char c, LexClass cls)
 {
-    while (t->input[t->pos] == ' ' || t->input[t->pos] == '\t')
+    switch (cls)
     {
-        t->pos++;
+    case LEX_BLANK:
+        return c == ' ' || c == '\t';
+    case LEX_WORD:
+        return is_alnum(c) || c == '.';
+    case LEX_DIGIT:
+    default:
+        return is_digit(c);
+    }
+}
+
+#ifdef LEX_WIDTH
+/* Bytes lo..hi (ASCII, so the signed compares hold) */
+static inline LexVector lex_range(LexVector v, char lo, char hi)
+{
+    return lex_and(lex_gt(v, lex_set((char)(lo - 1))), lex_gt(lex_set((char)(hi + 1)), v));
+}
+
+/* Bit i set where byte i of the vector is in the class */
+static inline LexMask lex_class_bits(LexVector v, LexClass cls)
+{
+    LexVector digits = lex_range(v, '0', '9');
+    switch (cls)
+    {
+    case LEX_BLANK:
+        return lex_bits(lex_or(lex_eq(v, lex_set(' ')), lex_eq(v, lex_set('\t'))));
+    case LEX_WORD:
+    {
+        LexVector letters = lex_range(lex_or(v, lex_set(0x20)), 'a', 'z'); /* Folded to lower case */
+        return lex_bits(lex_or(lex_or(letters, digits), lex_eq(v, lex_set('.'))));
+    }
+    case LEX_DIGIT:
+    default:
+        return lex_bits(digits);
+    }
+}
+
+/* First character from text on that is not in the class, end is the line's end */
+static inline const char *lex_span(const char *text, const char *end, LexClass cls)
+{
+    const LexMask all = (LexMask)((((uint64_t)1) << LEX_WIDTH) - 1);
+    for (; end - text >= LEX_WIDTH; text += LEX_WIDTH)
+    {
+        LexMask in_class = lex_class_bits(lex_load(text), cls);
+        if (in_class != all)
+            return text + __builtin_ctz(~in_class);
+    }
+    while (lex_in_class(*text, cls))
+    {
+        text++;
+    }
+    return text;
+}
+#else
+/* First character from text on that is not in the class */
+static inline const char *lex_span(const char *text, const char *end, LexClass cls)
+{
+    (void)end;
+    while (lex_in_class(*text, cls))
+    {
+        text++;
     }
+    return text;
+}
+#endif
+
+/* Skip whitespace */
+void skip_whitespace(Tokenizer *t)
+{
+    t->pos = (int)(lex_span(t->input + t->pos, t->input_end, LEX_BLANK) - t->input);
+}
+
+/* Record an error; the first one of the line is the one reported */
+static void tokenizer_error(Tokenizer *t, ErrorCode code)
+{
+    if (t->error == ERR_NONE)
+        t->error = code;
 }
 
 /* Token emission functions */
@@ -107,7 +206,7 @@ void emit_token(Tokenizer *t, Tok token)
 {
     if (t->token_len >= TOKBUF_LINE_MAX)
     {
-        error_report(ERR_LINE_TOO_LONG, t->line_num);
+        tokenizer_error(t, ERR_LINE_TOO_LONG);
         return;
     }
     t->tokens[t->token_len++] = (uint8_t)token;
@@ -117,7 +216,7 @@ void emit_token_u8(Tokenizer *t, Tok token, uint8_t data)
 {
     if (t->token_len + 2 > TOKBUF_LINE_MAX)
     {
-        error_report(ERR_LINE_TOO_LONG, t->line_num);
+        tokenizer_error(t, ERR_LINE_TOO_LONG);
         return;
     }
     t->tokens[t->token_len++] = (uint8_t)token;
@@ -128,24 +227,53 @@ void emit_token_u16(Tokenizer *t, Tok token, uint16_t data)
 {
     if (t->token_len + 3 > TOKBUF_LINE_MAX)
     {
-        error_report(ERR_LINE_TOO_LONG, t->line_num);
+        tokenizer_error(t, ERR_LINE_TOO_LONG);
         return;
     }
     t->tokens[t->token_len++] = (uint8_t)token;
-    *(uint16_t *)(t->tokens + t->token_len) = data;
-    t->token_len += 2;
+    t->tokens[t->token_len++] = (uint8_t)(data & 0xFF); /* Little endian, see get_u16() */
+    t->tokens[t->token_len++] = (uint8_t)(data >> 8);
 }
 
-void emit_token_double(Tokenizer *t, Tok token, double data)
+/* Emit a numeric literal: small integers inline, anything else via the constant pool */
+void emit_token_num(Tokenizer *t, double value)
 {
-    if (t->token_len + 9 > TOKBUF_LINE_MAX)
+    /* Literals are never negative (unary minus is an operator), range check before the cast */
+    if (0.0 <= value && value <= 0xFFFF && value == (double)(uint16_t)value)
     {
-        error_report(ERR_LINE_TOO_LONG, t->line_num);
+        if (value <= 0xFF)
+        {
+            emit_token_u8(t, T_INT8, (uint8_t)value);
+        }
+        else
+        {
+            emit_token_u16(t, T_INT16, (uint16_t)value);
+        }
         return;
     }
-    t->tokens[t->token_len++] = (uint8_t)token;
-    *(double *)(t->tokens + t->token_len) = data;
-    t->token_len += 8;
+
+    if (t->defer_consts)
+    {
+        /* The caller enters it in the pool: T_NUM indexes t->consts meanwhile */
+        if (t->token_len + 2 > TOKBUF_LINE_MAX)
+        {
+            tokenizer_error(t, ERR_LINE_TOO_LONG);
+            return;
+        }
+        t->consts[t->consts_len] = value;
+        emit_token_u8(t, T_NUM, (uint8_t)t->consts_len++);
+        return;
+    }
+
+    uint16_t index = program_add_const(value);
+    if (index <= 0xFF)
+    {
+        emit_token_u8(t, T_NUM, (uint8_t)index);
+    }
+    else
+    {
+        emit_token_u16(t, T_NUM16, index);
+    }
 }
 
 /* Emit string token without length restriction (for source literals, comments) */
@@ -153,7 +281,7 @@ void emit_token_string_unrestricted(Tokenizer *t, Tok token, const char *str, in
 {
     if (t->token_len + 2 + len > TOKBUF_LINE_MAX)
     {
-        error_report(ERR_LINE_TOO_LONG, t->line_num);
+        tokenizer_error(t, ERR_LINE_TOO_LONG);
         return;
     }
     t->tokens[t->token_len++] = (uint8_t)token;
@@ -182,6 +310,23 @@ void emit_token_string(Tokenizer *t, Tok token, const char *str, int len)
 bool parse_number(Tokenizer *t)
 {
     const char *start = t->input + t->pos;
+
+    /* Plain integers (most literals) are read from their digit span, exactly as strtod() would */
+    const char *digits_end = lex_span(start, t->input_end, LEX_DIGIT);
+    char after = *digits_end;
+    if (digits_end > start && digits_end - start <= NUMBER_EXACT_DIGITS &&
+        after != '.' && after != 'E' && after != 'e' && after != 'x' && after != 'X') /* Not a fraction, exponent or hex */
+    {
+        uint64_t integer = 0;
+        for (const char *pos = start; pos < digits_end; pos++)
+        {
+            integer = integer * 10 + (uint64_t)(*pos - '0');
+        }
+        t->pos = digits_end - t->input;
+        emit_token_num(t, (double)integer);
+        return true;
+    }
+
     char *end;
     double value = strtod(start, &end);
 
@@ -190,8 +335,25 @@ bool parse_number(Tokenizer *t)
         return false; /* Not a number */
     }
 
+    /* The display writes a positive exponent with a blank sign ("1.5E 12") */
+    if (toupper((unsigned char)end[0]) == 'E' && end[1] == ' ' && isdigit((unsigned char)end[2]))
+    {
+        char text[64];
+        int mantissa_len = (int)(end - start);
+        if (mantissa_len < (int)sizeof(text) - 8)
+        {
+            memcpy(text, start, mantissa_len);
+            text[mantissa_len] = 'E';
+            strncpy(text + mantissa_len + 1, end + 2, 6);
+            text[mantissa_len + 7] = '\0';
+            char *exp_end;
+            value = strtod(text, &exp_end);
+            end += 2 + (exp_end - text - mantissa_len - 1);
+        }
+    }
+
     t->pos = end - t->input;
-    emit_token_double(t, T_NUM, value);
+    emit_token_num(t, value);
     return true;
 }
 
@@ -208,7 +370,7 @@ bool parse_string(Tokenizer *t)
     int len = 0;
 
     /* Find closing quote */
-    while (t->input[t->pos] != '\0' && t->input[t->pos] != '"')
+    while (!is_line_end(t->input[t->pos]) && t->input[t->pos] != '"')
     {
         t->pos++;
         len++;
@@ -216,7 +378,7 @@ bool parse_string(Tokenizer *t)
 
     if (t->input[t->pos] != '"')
     {
-        error_report(ERR_SYNTAX_ERROR, t->line_num);
+        tokenizer_error(t, ERR_SYNTAX_ERROR);
         return false;
     }
 
@@ -259,18 +421,18 @@ bool parse_variable(Tokenizer *t)
 
         /* Parse expression inside parentheses */
         int paren_count = 1;
-        while (paren_count > 0 && t->input[t->pos] != '\0')
+        while (paren_count > 0 && !is_line_end(t->input[t->pos]) && t->error == ERR_NONE)
         {
             if (!tokenize_expression_recursive(t, &paren_count))
             {
-                error_report(ERR_SYNTAX_ERROR, t->line_num);
+                tokenizer_error(t, ERR_SYNTAX_ERROR);
                 return false;
             }
         }
 
         if (paren_count != 0)
         {
-            error_report(ERR_SYNTAX_ERROR, t->line_num);
+            tokenizer_error(t, ERR_SYNTAX_ERROR);
             return false;
         }
 
@@ -297,7 +459,7 @@ static bool tokenize_expression_recursive(Tokenizer *t, int *paren_count)
 {
     skip_whitespace(t);
 
-    if (t->input[t->pos] == '\0')
+    if (is_line_end(t->input[t->pos]))
     {
         return false;
     }
@@ -350,27 +512,18 @@ bool parse_keyword(Tokenizer *t)
     }
 
     const char *start = t->input + t->pos;
-    int len = 0;
 
     /* Read alphanumeric characters and dots */
-    while (is_alnum(t->input[t->pos]) || t->input[t->pos] == '.')
-    {
-        t->pos++;
-        len++;
-    }
-
-    /* Extract word */
-    char word[32];
-    if (len >= (int)sizeof(word))
+    int len = (int)(lex_span(start, t->input_end, LEX_WORD) - start);
+    t->pos += len;
+    if (len >= KEYWORD_WORD_MAX)
     {
-        error_report(ERR_SYNTAX_ERROR, t->line_num);
+        tokenizer_error(t, ERR_SYNTAX_ERROR);
         return false;
     }
-    strncpy(word, start, len);
-    word[len] = '\0';
 
-    /* Look up keyword */
-    const Keyword *kw = find_keyword(word);
+    /* Look up keyword, in place */
+    const Keyword *kw = find_keyword_len(start, len);
     if (kw)
     {
         /* Handle special cases that need additional data */
@@ -388,7 +541,7 @@ bool parse_keyword(Tokenizer *t)
             {
                 if (!parse_number(t))
                 {
-                    error_report(ERR_SYNTAX_ERROR, t->line_num);
+                    tokenizer_error(t, ERR_SYNTAX_ERROR);
                     return false;
                 }
             }
@@ -407,7 +560,7 @@ bool parse_keyword(Tokenizer *t)
         return parse_variable(t);
     }
 
-    error_report(ERR_SYNTAX_ERROR, t->line_num);
+    tokenizer_error(t, ERR_SYNTAX_ERROR);
     return false;
 }
 
@@ -497,33 +650,35 @@ bool parse_operator(Tokenizer *t)
     }
 }
 
-/* Tokenize a single line */
-bool tokenize_line(const char *line, uint16_t line_num, uint8_t *tokens, int *token_len)
+/* Tokenize a single line into t->tokens, returning the first error instead of reporting it */
+ErrorCode tokenize_line_run(Tokenizer *t, const char *line, uint32_t line_num)
 {
-    Tokenizer t = {0};
-    t.input = line;
-    t.pos = 0;
-    t.line_num = line_num;
-    t.token_len = 0;
+    t->input = line;
+    t->input_end = line + strcspn(line, "\n");
+    t->pos = 0;
+    t->line_num = line_num;
+    t->token_len = 0;
+    t->consts_len = 0;
+    t->error = ERR_NONE;
 
-    skip_whitespace(&t);
+    skip_whitespace(t);
 
     /* Handle empty line or comment-only line */
-    if (t.input[t.pos] == '\0' ||
-        (strncasecmp(t.input + t.pos, "REM", 3) == 0 &&
-         (t.input[t.pos + 3] == ' ' || t.input[t.pos + 3] == '\0')))
+    if (is_line_end(t->input[t->pos]) ||
+        (strncasecmp(t->input + t->pos, "REM", 3) == 0 &&
+         (t->input[t->pos + 3] == ' ' || is_line_end(t->input[t->pos + 3]))))
     {
 
-        if (t.input[t.pos] != '\0')
+        if (!is_line_end(t->input[t->pos]))
         {
             /* REM statement - store the comment */
-            t.pos += 3; /* Skip "REM" */
-            skip_whitespace(&t);
-            emit_token(&t, T_REM);
+            t->pos += 3; /* Skip "REM" */
+            skip_whitespace(t);
+            emit_token(t, T_REM);
 
             /* Store rest of line as string */
-            const char *comment = t.input + t.pos;
-            int comment_len = strlen(comment);
+            const char *comment = t->input + t->pos;
+            int comment_len = (int)(t->input_end - comment);
             /* Trim trailing whitespace */
             while (comment_len > 0 &&
                    (comment[comment_len - 1] == ' ' || comment[comment_len - 1] == '\t'))
@@ -532,117 +687,58 @@ bool tokenize_line(const char *line, uint16_t line_num, uint8_t *tokens, int *to
             }
             if (comment_len > 0)
             {
-                emit_token_string_unrestricted(&t, T_STR, comment, comment_len);
+                emit_token_string_unrestricted(t, T_STR, comment, comment_len);
             }
         }
-
-        *token_len = t.token_len;
-        memcpy(tokens, t.tokens, t.token_len);
-        return true;
+        return t->error;
     }
 
-    /* Parse tokens until end of line */
-    while (t.input[t.pos] != '\0')
+    /* Parse tokens until end of line or the first error */
+    while (!is_line_end(t->input[t->pos]) && t->error == ERR_NONE)
     {
-        skip_whitespace(&t);
-        if (t.input[t.pos] == '\0')
+        skip_whitespace(t);
+        if (is_line_end(t->input[t->pos]))
             break;
 
         bool parsed = false;
 
         /* Try parsing in order of precedence */
-        if (t.input[t.pos] == '"')
+        if (t->input[t->pos] == '"')
         {
-            parsed = parse_string(&t);
+            parsed = parse_string(t);
         }
-        else if (is_digit(t.input[t.pos]) || t.input[t.pos] == '.')
+        else if (is_digit(t->input[t->pos]) || t->input[t->pos] == '.')
         {
-            parsed = parse_number(&t);
+            parsed = parse_number(t);
         }
-        else if (is_alpha(t.input[t.pos]))
+        else if (is_alpha(t->input[t->pos]))
         {
-            parsed = parse_keyword(&t);
+            parsed = parse_keyword(t);
         }
         else
         {
-            parsed = parse_operator(&t);
+            parsed = parse_operator(t);
         }
 
         if (!parsed)
-        {
-            error_report(ERR_SYNTAX_ERROR, line_num);
-            return false;
-        }
+            tokenizer_error(t, ERR_SYNTAX_ERROR);
     }
-
-    *token_len = t.token_len;
-    memcpy(tokens, t.tokens, t.token_len);
-    return true;
+    return t->error;
 }
 
-/* Tokenize a file */
-bool tokenize_file(const char *filename)
+/* Tokenize a single line, reporting an error */
+bool tokenize_line(const char *line, uint32_t line_num, uint8_t *tokens, int *token_len)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
+    Tokenizer t;
+    t.defer_consts = false;
+    ErrorCode error = tokenize_line_run(&t, line, line_num);
+    if (error != ERR_NONE)
     {
-        fprintf(stderr, "Cannot open file: %s\n", filename);
+        error_report(error, line_num);
         return false;
     }
 
-    char line_buffer[512];
-    int lines_loaded = 0;
-
-    while (fgets(line_buffer, sizeof(line_buffer), file))
-    {
-        /* Remove newline */
-        int len = strlen(line_buffer);
-        if (len > 0 && line_buffer[len - 1] == '\n')
-        {
-            line_buffer[len - 1] = '\0';
-        }
-
-        /* Skip empty lines */
-        if (strlen(line_buffer) == 0)
-            continue;
-
-        /* Parse line number */
-        char *endptr;
-        long line_num = strtol(line_buffer, &endptr, 10);
-        if (line_num <= 0 || line_num > LINE_NUM_MAX || endptr == line_buffer)
-        {
-            fprintf(stderr, "Invalid line number in: %s\n", line_buffer);
-            fclose(file);
-            return false;
-        }
-
-        /* Skip whitespace after line number */
-        while (*endptr == ' ' || *endptr == '\t')
-        {
-            endptr++;
-        }
-
-        /* Tokenize the rest of the line */
-        uint8_t tokens[TOKBUF_LINE_MAX];
-        int token_len;
-
-        if (!tokenize_line(endptr, (uint16_t)line_num, tokens, &token_len))
-        {
-            fclose(file);
-            return false;
-        }
-
-        /* Add to program */
-        if (!program_add_line((uint16_t)line_num, tokens, token_len))
-        {
-            fclose(file);
-            return false;
-        }
-
-        lines_loaded++;
-    }
-
-    fclose(file);
-    printf("Loaded %d lines\n", lines_loaded);
+    *token_len = t.token_len;
+    memcpy(tokens, t.tokens, t.token_len);
     return true;
 }
@@ -17,15 +17,22 @@ typedef struct
 typedef struct
 {
     const char *input;               /* Input string */
+    const char *input_end;           /* Its newline or NUL */
     int pos;                         /* Current position */
     int line_num;                    /* Current line number being parsed */
     uint8_t tokens[TOKBUF_LINE_MAX]; /* Output token buffer */
     int token_len;                   /* Current token buffer length */
+    ErrorCode error;                 /* First error of the line, ERR_NONE */
+    bool defer_consts;               /* Leave pool constants in consts[] (T_NUM indexes it) for the caller */
+    int consts_len;
+    double consts[TOKBUF_LINE_MAX / 2];
 } Tokenizer;
 
-/* Main tokenization functions */
-bool tokenize_line(const char *line, uint16_t line_num, uint8_t *tokens, int *token_len);
-bool tokenize_file(const char *filename);
+/* Main tokenization functions.
+ * A line ends at its newline or NUL. tokenize_line() reports an error,
+ * tokenize_line_run() only returns it (ERR_NONE) and leaves the tokens in t */
+bool tokenize_line(const char *line, uint32_t line_num, uint8_t *tokens, int *token_len);
+ErrorCode tokenize_line_run(Tokenizer *t, const char *line, uint32_t line_num);
 
 /* Individual token parsing */
 bool parse_number(Tokenizer *t);
@@ -45,7 +52,7 @@ const Keyword *find_keyword(const char *word);
 void emit_token(Tokenizer *t, Tok token);
 void emit_token_u8(Tokenizer *t, Tok token, uint8_t data);
 void emit_token_u16(Tokenizer *t, Tok token, uint16_t data);
-void emit_token_double(Tokenizer *t, Tok token, double data);
+void emit_token_num(Tokenizer *t, double value);
 void emit_token_string(Tokenizer *t, Tok token, const char *str, int len);
 void emit_token_string_unrestricted(Tokenizer *t, Tok token, const char *str, int len);
 
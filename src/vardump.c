@@ -0,0 +1,122 @@
+#include "vardump.h"
+#include "program.h"
+#include "errors.h"
+#include "output.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+enum
+{
+    DUMP_BUFFER_SIZE = 65536,
+    DUMP_ITEM_MAX = 96 /* Longest JSON item: the header, a number, or an escaped string */
+};
+
+static char dump_buffer[DUMP_BUFFER_SIZE];
+static uint32_t dump_len;
+static int dump_fd;
+static bool dump_failed;
+
+/* Write the buffer out */
+static void dump_flush(void)
+{
+    if (!fd_write_all(dump_fd, dump_buffer, dump_len))
+        dump_failed = true;
+    dump_len = 0;
+}
+
+/* Make room for an item of up to len bytes */
+static char *dump_reserve(uint32_t len)
+{
+    assert(len <= DUMP_BUFFER_SIZE);
+    if (DUMP_BUFFER_SIZE - dump_len < len)
+        dump_flush();
+    return dump_buffer + dump_len;
+}
+
+static void dump_bytes(const void *bytes, uint32_t len)
+{
+    memcpy(dump_reserve(len), bytes, len);
+    dump_len += len;
+}
+
+static void dump_json_cell(const VarCell *cell)
+{
+    char *out = dump_reserve(DUMP_ITEM_MAX);
+    if (var_is_str(cell))
+    {
+        char str[STR_MAX + 1];
+        int len = str_word_get(var_cell_get_word(cell), str);
+        *out++ = '"';
+        for (int i = 0; i < len; i++)
+        {
+            unsigned char c = (unsigned char)str[i];
+            if (c == '"' || c == '\\')
+                *out++ = '\\';
+            if (c < 0x20 || c >= 0x7F)
+                out += sprintf(out, "\\u%04x", c);
+            else
+                *out++ = (char)c;
+        }
+        *out++ = '"';
+    }
+    else if (isfinite(cell->num))
+        out += sprintf(out, "%.17g", cell->num);
+    else
+        out += sprintf(out, "null");
+    dump_len = (uint32_t)(out - dump_buffer);
+}
+
+static void dump_json(int first, int last)
+{
+    char *out = dump_reserve(DUMP_ITEM_MAX);
+    out += sprintf(out, "{\"error\":%d,\"line\":%d,\"first\":%d,\"vars\":[",
+                   (int)error_get_code(), g_error_line, first);
+    dump_len = (uint32_t)(out - dump_buffer);
+
+    for (int index = first; index <= last; index++)
+    {
+        if (index > first)
+            dump_bytes(",", 1);
+        dump_json_cell(var_cell_load(index));
+    }
+    dump_bytes("]}\n", 3);
+}
+
+static void dump_bin(int first, int last)
+{
+    uint32_t header[4] = {(uint32_t)error_get_code(), (uint32_t)g_error_line,
+                          (uint32_t)first, (uint32_t)(last - first + 1)};
+    dump_bytes("PCV1", 4);
+    dump_bytes(header, sizeof(header));
+    for (int index = first; index <= last; index++)
+        dump_bytes(&var_cell_load(index)->bits, sizeof(uint64_t));
+}
+
+bool var_dump(VarDumpFormat format, int fd, int first, int last)
+{
+    assert(1 <= first && first <= last && last <= g_program.vars_max);
+
+    /* Anything already printed comes first */
+    output_flush();
+    fflush(stdout);
+
+    dump_fd = fd;
+    dump_len = 0;
+    dump_failed = false;
+    switch (format)
+    {
+    case VAR_DUMP_JSON:
+        dump_json(first, last);
+        break;
+    case VAR_DUMP_BIN:
+        dump_bin(first, last);
+        break;
+    case VAR_DUMP_NONE:
+        assert(false);
+        break;
+    }
+    dump_flush();
+    return !dump_failed;
+}
@@ -0,0 +1,26 @@
+#ifndef VARDUMP_H
+#define VARDUMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* End-of-run variable dump for machine consumers: A(first..last) with the
+ * run's error code and line, written straight to a file descriptor.
+ *
+ * JSON: {"error":0,"line":0,"first":1,"vars":[1.5,"ABC",0,...]}
+ *   numbers with 17 significant digits (exact), strings as JSON strings.
+ * Binary (host byte order):
+ *   char magic[4] = "PCV1"; uint32_t error, line, first, count;
+ *   uint64_t cells[count]: the raw 8 byte cells (see VarCell), a string has
+ *   VAR_STR_TAG in its top byte and its characters from the low byte up. */
+
+typedef enum
+{
+    VAR_DUMP_NONE,
+    VAR_DUMP_JSON,
+    VAR_DUMP_BIN
+} VarDumpFormat;
+
+bool var_dump(VarDumpFormat format, int fd, int first, int last);
+
+#endif /* VARDUMP_H */
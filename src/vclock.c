@@ -0,0 +1,92 @@
+#include "vclock.h"
+#include <time.h>
+#include <assert.h>
+
+static VClockMode vclock_current_mode;
+static double vclock_scale;
+static uint64_t vclock_elapsed; /* Virtual microseconds */
+static bool vclock_tone_wait;
+
+void vclock_init(void)
+{
+    vclock_current_mode = VCLOCK_REAL;
+    vclock_scale = 1.0;
+    vclock_elapsed = 0;
+    vclock_tone_wait = false;
+}
+
+void vclock_set_mode(VClockMode mode, double scale)
+{
+    assert(scale >= 0);
+    vclock_current_mode = mode;
+    vclock_scale = mode == VCLOCK_SCALED ? scale : 1.0;
+}
+
+VClockMode vclock_mode(void)
+{
+    return vclock_current_mode;
+}
+
+/* Real time seconds after base */
+static struct timespec vclock_after(struct timespec base, double seconds)
+{
+    time_t whole = (time_t)seconds;
+    base.tv_sec += whole;
+    base.tv_nsec += (long)((seconds - (double)whole) * 1e9);
+    if (base.tv_nsec >= 1000000000L)
+    {
+        base.tv_sec++;
+        base.tv_nsec -= 1000000000L;
+    }
+    return base;
+}
+
+/* Sleep until a CLOCK_MONOTONIC deadline: nanosleep() for what remains,
+ * measured again after each wake-up (early, or interrupted by a signal) */
+static void vclock_sleep_until(struct timespec deadline)
+{
+    for (;;)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long remaining = (long long)(deadline.tv_sec - now.tv_sec) * 1000000000LL + (deadline.tv_nsec - now.tv_nsec);
+        if (remaining <= 0)
+            return;
+        struct timespec wait = {(time_t)(remaining / 1000000000LL), (long)(remaining % 1000000000LL)};
+        nanosleep(&wait, NULL);
+    }
+}
+
+void vclock_wait(uint32_t usec)
+{
+    vclock_elapsed += usec;
+    if (vclock_current_mode == VCLOCK_INSTANT)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    vclock_sleep_until(vclock_after(now, usec * vclock_scale / 1e6));
+}
+
+void vclock_advance(uint32_t usec)
+{
+    vclock_elapsed += usec;
+}
+
+void vclock_set_tone_wait(bool wait)
+{
+    vclock_tone_wait = wait;
+}
+
+void vclock_tone(uint32_t usec)
+{
+    if (vclock_tone_wait)
+        vclock_wait(usec);
+    else
+        vclock_advance(usec);
+}
+
+uint64_t vclock_usec(void)
+{
+    return vclock_elapsed;
+}
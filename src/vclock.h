@@ -0,0 +1,42 @@
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Virtual time base for the statements that take time on the device (PAUSE,
+ * BEEP). They advance the virtual clock by their duration, and the mode
+ * decides how much of it is actually waited for. */
+
+enum
+{
+    PAUSE_USEC = 100000, /* PAUSE shows its line this long */
+    BEEP_USEC = 100000   /* Length of the BEEP tone */
+};
+
+typedef enum
+{
+    VCLOCK_REAL,   /* Wait for the full duration */
+    VCLOCK_SCALED, /* Wait for the duration times the scale */
+    VCLOCK_INSTANT /* Do not wait: only the virtual time advances */
+} VClockMode;
+
+void vclock_init(void); /* Real time, no time elapsed */
+void vclock_set_mode(VClockMode mode, double scale);
+VClockMode vclock_mode(void);
+
+/* Spend usec of device time */
+void vclock_wait(uint32_t usec);
+
+/* Advance the device time without waiting */
+void vclock_advance(uint32_t usec);
+
+/* A tone (BEEP) of usec: the device time advances, but it is only waited for
+ * (as vclock_wait()) once tones are set to wait; by default the run goes on */
+void vclock_set_tone_wait(bool wait);
+void vclock_tone(uint32_t usec);
+
+/* Device time spent so far */
+uint64_t vclock_usec(void);
+
+#endif /* VCLOCK_H */
@@ -1,27 +1,63 @@
 #include "vm.h"
 #include "program.h"
 #include "errors.h"
+#include "output.h"
+#include "input.h"
+#include "vclock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
 #include <assert.h>
-#include <unistd.h>
 
-/* Global VM state */
-VM g_vm;
+/* Global VM state, aligned so the hot fields share a single cache line */
+VM g_vm __attribute__((aligned(VM_CACHE_LINE)));
+
+/* Split the stack storage between the two stacks. A stack whose depth the
+ * load-time analysis proved (bound >= 0) gets exactly that many frames and no
+ * overflow check; the other one gets the rest, up to GOSUB_MAX/FOR_MAX, and
+ * is checked. If the proven bounds do not fit beside the default share of
+ * the other stack, the default split is kept and both stacks are checked */
+static void vm_size_stacks(int call_depth, int for_depth)
+{
+    int call_max = call_depth < 0 ? VM_CALL_FRAMES : call_depth;
+    int for_max = for_depth < 0 ? VM_FOR_FRAMES : for_depth;
+    if (VM_STACK_BYTES < call_max * sizeof(CallFrame) + for_max * sizeof(ForFrame))
+    {
+        call_depth = for_depth = -1;
+        call_max = VM_CALL_FRAMES;
+        for_max = VM_FOR_FRAMES;
+    }
+
+    size_t spare = VM_STACK_BYTES - call_max * sizeof(CallFrame) - for_max * sizeof(ForFrame);
+    if (call_depth < 0 && for_depth >= 0)
+        call_max += spare / sizeof(CallFrame);
+    if (for_depth < 0 && call_depth >= 0)
+        for_max += spare / sizeof(ForFrame);
+    g_vm.call_max = call_max < GOSUB_MAX ? call_max : GOSUB_MAX;
+    g_vm.for_max = for_max < FOR_MAX ? for_max : FOR_MAX;
+    g_vm.call_checked = call_depth < 0;
+    g_vm.for_checked = for_depth < 0;
+
+    g_vm.for_frames = g_vm.stack_storage;
+    g_vm.call_frames = (CallFrame *)(g_vm.stack_storage + g_vm.for_max);
+    assert(g_vm.for_max * sizeof(ForFrame) + g_vm.call_max * sizeof(CallFrame) <= VM_STACK_BYTES);
+}
 
 /* Initialize VM */
 void vm_init(void)
 {
+    assert(VM_HOT_END <= VM_CACHE_LINE);
+    assert(VM_STACK_BYTES % sizeof(ForFrame) == 0);
+
     g_vm.pc = NULL;
     g_vm.current_line_ptr = NULL;
     g_vm.running = false;
     g_vm.angle_mode = ANGLE_RADIAN; /* Default to radians */
-    g_vm.expr_stack.top = 0;
-    g_vm.call_stack.top = 0;
-    g_vm.for_stack.top = 0;
+    g_vm.call_top = 0;
+    g_vm.for_top = 0;
+    vm_size_stacks(-1, -1);
 
     /* Initialize AREAD state */
     g_vm.aread_string[0] = '\0';
@@ -35,22 +71,32 @@ void vm_init(void)
 static VMPosition vm_capture_position(void)
 {
     VMPosition pos;
-    pos.pc = g_vm.pc;
-    pos.line_ptr = g_vm.current_line_ptr;
+    pos.pc_off = (uint32_t)(g_vm.pc - g_program.prog);
+    pos.line_off = (uint32_t)(g_vm.current_line_ptr - g_program.prog);
     return pos;
 }
 
 static void vm_restore_position(VMPosition pos)
 {
-    g_vm.pc = pos.pc;
-    g_vm.current_line_ptr = pos.line_ptr;
+    g_vm.pc = g_program.prog + pos.pc_off;
+    g_vm.current_line_ptr = g_program.prog + pos.line_off;
+    program_validate_line_ptr(g_vm.current_line_ptr);
+}
+
+/* Continue execution at the first token of a line */
+static void vm_enter_line(uint8_t *line_ptr)
+{
+    if (program_is_lazy(line_ptr)) /* Lazy loading: tokenized on first entry */
+        program_tokenize_lazy(line_ptr);
+    g_vm.pc = get_tokens(line_ptr);
+    g_vm.current_line_ptr = line_ptr;
 }
 
 void vm_goto_line_ptr(uint8_t *line_ptr)
 {
     program_validate_line_ptr(line_ptr);
 
-    if (program_is_last_line(line_ptr))
+    if (program_at_end(line_ptr))
     {
         g_vm.current_line_ptr = line_ptr;
         g_vm.pc = NULL;
@@ -58,10 +104,7 @@ void vm_goto_line_ptr(uint8_t *line_ptr)
         return;
     }
 
-    VMPosition pos;
-    pos.pc = get_tokens(line_ptr);
-    pos.line_ptr = line_ptr;
-    vm_restore_position(pos);
+    vm_enter_line(line_ptr);
 }
 
 /* Start program at first line */
@@ -82,11 +125,7 @@ static void vm_next_line(void)
         return;
     }
 
-    g_vm.current_line_ptr = program_next_line(g_vm.current_line_ptr);
-    VMPosition pos;
-    pos.pc = get_tokens(g_vm.current_line_ptr);
-    pos.line_ptr = g_vm.current_line_ptr;
-    vm_restore_position(pos);
+    vm_enter_line(program_next_line(g_vm.current_line_ptr));
 }
 
 void vm_error_set(ErrorCode code)
@@ -102,77 +141,128 @@ void vm_error_if(bool condition, ErrorCode code)
     }
 }
 
-/* Go to specific line number - scans to find line */
-static void vm_goto_line(uint16_t target_line)
+/* Store a number in a variable cell, overflow if it would read back as a string */
+static void vm_set_num(VarCell *cell, double value)
+{
+    vm_error_if(!var_num_storable(value), ERR_MATH_OVERFLOW);
+    var_cell_set_num(cell, value);
+}
+
+/* Check an A(n) index value (truncated toward zero) against the variable range */
+static int vm_var_index(double index_val)
 {
-    uint8_t *line_ptr = program_find_line(target_line);
+    vm_error_if(!(1 <= index_val && index_val < (double)g_program.vars_max + 1), ERR_INDEX_OUT_OF_RANGE);
+    return (int)index_val;
+}
+
+/* Cell of A(n) for reading - a zero cell if it was never stored */
+static const VarCell *vm_var_load(double index_val)
+{
+    return var_cell_load(vm_var_index(index_val));
+}
+
+/* Cell of A(n) for writing - out of variable memory is reported as a bad index */
+static VarCell *vm_var_store(double index_val)
+{
+    VarCell *cell = var_cell_store(vm_var_index(index_val));
+    vm_error_if(!cell, ERR_INDEX_OUT_OF_RANGE);
+    return cell;
+}
+
+/* Go to specific line number (value of a GOTO/GOSUB/THEN expression) */
+static void vm_goto_line(double target_line)
+{
+    vm_error_if(!(1 <= target_line && target_line < (double)g_program.line_num_max + 1), ERR_BAD_LINE_NUMBER);
+    uint8_t *line_ptr = program_find_line((uint32_t)target_line);
     vm_error_if(!line_ptr, ERR_BAD_LINE_NUMBER);
 
-    VMPosition pos;
-    pos.pc = get_tokens(line_ptr);
-    pos.line_ptr = line_ptr;
-    vm_restore_position(pos);
+    vm_enter_line(line_ptr);
 }
 
 /* Go to label - looks up label then goes to line */
-static void vm_goto_label(const char *label)
+static void vm_goto_label(StrWord label)
 {
     uint8_t *line_ptr = program_find_line_label(label);
     vm_error_if(!line_ptr, ERR_LABEL_NOT_FOUND);
     vm_goto_line_ptr(line_ptr);
 }
 
-/* Push value onto expression stack */
-void vm_push_value(double value)
+/* Push call frame onto call stack (only the PC is stored, the line is recovered on pop) */
+void vm_push_call(VMPosition return_pos)
 {
-    vm_error_if(g_vm.expr_stack.top >= EXPR_STACK_SIZE, ERR_STACK_OVERFLOW);
-    g_vm.expr_stack.values[g_vm.expr_stack.top++] = value;
+    assert(program_find_line_containing(g_program.prog + return_pos.pc_off) == g_program.prog + return_pos.line_off);
+    if (g_vm.call_checked) /* Else the load-time analysis proved the depth fits */
+        vm_error_if(g_vm.call_top >= g_vm.call_max, ERR_STACK_OVERFLOW);
+    assert(g_vm.call_top < g_vm.call_max);
+    g_vm.call_frames[g_vm.call_top].return_pc = return_pos.pc_off;
+    g_vm.call_top++;
 }
 
-/* Pop value from expression stack */
-double vm_pop_value(void)
+/* Pop call frame from call stack */
+bool vm_pop_call(VMPosition *return_pos)
 {
-    assert(g_vm.expr_stack.top > 0); /* Stack underflow is a programming error */
-    return g_vm.expr_stack.values[--g_vm.expr_stack.top];
+    vm_error_if(g_vm.call_top <= 0, ERR_RETURN_WITHOUT_GOSUB);
+    g_vm.call_top--;
+    return_pos->pc_off = g_vm.call_frames[g_vm.call_top].return_pc;
+    return_pos->line_off = (uint32_t)(program_find_line_containing(g_program.prog + return_pos->pc_off) - g_program.prog);
+    return true;
 }
 
-/* Push call frame onto call stack */
-void vm_push_call(VMPosition return_pos)
+/* Check if execution resumed at pc would immediately hit a RETURN
+ * (following ':' separators and the end of the line into the next one) */
+static bool vm_is_return_next(uint8_t *pc)
 {
-    vm_error_if(g_vm.call_stack.top >= CALL_STACK_SIZE, ERR_STACK_OVERFLOW);
-    g_vm.call_stack.frames[g_vm.call_stack.top].return_pos = return_pos;
-    g_vm.call_stack.top++;
+    uint8_t *line_ptr = program_find_line_containing(pc);
+    while (*pc == T_COLON || *pc == T_EOL)
+    {
+        if (*pc == T_COLON)
+        {
+            pc++;
+            continue;
+        }
+        line_ptr = program_next_line(line_ptr);
+        if (program_is_last_line(line_ptr))
+            return false;
+        if (program_is_lazy(line_ptr)) /* Not run yet: tokenizing it could fail before its turn */
+            return false;
+        pc = get_tokens(line_ptr);
+    }
+    return *pc == T_RETURN;
 }
 
-/* Pop call frame from call stack */
-bool vm_pop_call(VMPosition *return_pos)
+/* Push the return address for a GOSUB, unless it is a tail call.
+ * When the caller would RETURN right after the GOSUB, the callee's RETURN can go
+ * straight to the caller's caller, so the current frame is reused.
+ * With an empty stack the RETURN must still fail on its own line, so we push. */
+static void vm_push_gosub_return(VMPosition return_pos)
 {
-    vm_error_if(g_vm.call_stack.top <= 0, ERR_RETURN_WITHOUT_GOSUB);
-    g_vm.call_stack.top--;
-    *return_pos = g_vm.call_stack.frames[g_vm.call_stack.top].return_pos;
-    return true;
+    if (g_vm.call_top > 0 && vm_is_return_next(g_program.prog + return_pos.pc_off))
+        return;
+    vm_push_call(return_pos);
 }
 
 /* Push FOR frame onto FOR stack */
 void vm_push_for(VMPosition body, uint8_t var_idx, double limit, double step)
 {
-    vm_error_if(g_vm.for_stack.top >= FOR_STACK_SIZE, ERR_STACK_OVERFLOW);
-    g_vm.for_stack.frames[g_vm.for_stack.top].body = body;
-    g_vm.for_stack.frames[g_vm.for_stack.top].var_idx = var_idx;
-    g_vm.for_stack.frames[g_vm.for_stack.top].limit = limit;
-    g_vm.for_stack.frames[g_vm.for_stack.top].step = step;
-    g_vm.for_stack.top++;
+    if (g_vm.for_checked) /* Else the load-time analysis proved the depth fits */
+        vm_error_if(g_vm.for_top >= g_vm.for_max, ERR_STACK_OVERFLOW);
+    assert(g_vm.for_top < g_vm.for_max);
+    g_vm.for_frames[g_vm.for_top].body = body;
+    g_vm.for_frames[g_vm.for_top].var_idx = var_idx;
+    g_vm.for_frames[g_vm.for_top].limit = limit;
+    g_vm.for_frames[g_vm.for_top].step = step;
+    g_vm.for_top++;
 }
 
 /* Pop FOR frame from FOR stack */
 bool vm_pop_for(VMPosition *body, uint8_t *var_idx, double *limit, double *step)
 {
-    vm_error_if(g_vm.for_stack.top <= 0, ERR_NEXT_WITHOUT_FOR);
-    g_vm.for_stack.top--;
-    *body = g_vm.for_stack.frames[g_vm.for_stack.top].body;
-    *var_idx = g_vm.for_stack.frames[g_vm.for_stack.top].var_idx;
-    *limit = g_vm.for_stack.frames[g_vm.for_stack.top].limit;
-    *step = g_vm.for_stack.frames[g_vm.for_stack.top].step;
+    vm_error_if(g_vm.for_top <= 0, ERR_NEXT_WITHOUT_FOR);
+    g_vm.for_top--;
+    *body = g_vm.for_frames[g_vm.for_top].body;
+    *var_idx = g_vm.for_frames[g_vm.for_top].var_idx;
+    *limit = g_vm.for_frames[g_vm.for_top].limit;
+    *step = g_vm.for_frames[g_vm.for_top].step;
     return true;
 }
 
@@ -180,9 +270,9 @@ bool vm_pop_for(VMPosition *body, uint8_t *var_idx, double *limit, double *step)
 bool vm_find_for_by_var(uint8_t var_idx, int *frame_index)
 {
     /* Search from top of stack downward */
-    for (int i = g_vm.for_stack.top - 1; i >= 0; i--)
+    for (int i = g_vm.for_top - 1; i >= 0; i--)
     {
-        if (g_vm.for_stack.frames[i].var_idx == var_idx)
+        if (g_vm.for_frames[i].var_idx == var_idx)
         {
             *frame_index = i;
             return true;
@@ -316,10 +406,12 @@ static double eval_factor_auto(uint8_t **pc_ptr)
     switch (token)
     {
     case T_NUM:
+    case T_NUM16:
+    case T_INT8:
+    case T_INT16:
     {
-        (*pc_ptr)++;
-        double value = *(double *)*pc_ptr;
-        *pc_ptr += sizeof(double);
+        double value = token_num_value(*pc_ptr);
+        *pc_ptr += token_num_len(*pc_ptr);
         return value;
     }
 
@@ -330,8 +422,8 @@ static double eval_factor_auto(uint8_t **pc_ptr)
         (*pc_ptr)++;
         vm_error_if(var_idx < 1 || var_idx > 26, ERR_INDEX_OUT_OF_RANGE);
         VarCell *cell = &g_program.vars[var_idx - 1];
-        vm_error_if(cell->type != VAR_NUM, ERR_TYPE_MISMATCH);
-        return cell->value.num;
+        vm_error_if(var_is_str(cell), ERR_TYPE_MISMATCH);
+        return cell->num;
     }
 
     case T_VIDX:
@@ -347,13 +439,10 @@ static double eval_factor_auto(uint8_t **pc_ptr)
             (*pc_ptr)++;
         }
 
-        /* Convert to integer index (truncate toward zero) */
-        int index = (int)index_val;
-        vm_error_if(index < 1 || index > VARS_MAX, ERR_INDEX_OUT_OF_RANGE);
+        const VarCell *cell = vm_var_load(index_val);
 
-        VarCell *cell = &g_program.vars[index - 1];
-        vm_error_if(cell->type != VAR_NUM, ERR_TYPE_MISMATCH);
-        return cell->value.num;
+        vm_error_if(var_is_str(cell), ERR_TYPE_MISMATCH);
+        return cell->num;
     }
 
     case T_LP:
@@ -593,8 +682,8 @@ static double eval_factor_auto(uint8_t **pc_ptr)
     }
 }
 
-/* Simple string evaluation for IF conditions - returns string in buffer, max 7 chars + null */
-static bool eval_string_expression(uint8_t **pc_ptr, char *result_buffer)
+/* Simple string evaluation for IF conditions - returns the string as a word */
+static bool eval_string_expression(uint8_t **pc_ptr, StrWord *result)
 {
     uint8_t token = **pc_ptr;
 
@@ -606,10 +695,8 @@ static bool eval_string_expression(uint8_t **pc_ptr, char *result_buffer)
         uint8_t str_len = **pc_ptr;
         (*pc_ptr)++;
 
-        /* Copy up to 7 characters */
-        int copy_len = (str_len > 7) ? 7 : str_len;
-        memcpy(result_buffer, *pc_ptr, copy_len);
-        result_buffer[copy_len] = '\0';
+        /* Keep up to STR_MAX characters */
+        *result = str_word_make((const char *)*pc_ptr, str_len);
 
         *pc_ptr += str_len; /* Skip all string data */
         return true;
@@ -627,17 +714,8 @@ static bool eval_string_expression(uint8_t **pc_ptr, char *result_buffer)
             return false;
         }
 
-        VarCell *cell = &g_program.vars[var_idx - 1];
-        if (cell->type != VAR_STR)
-        {
-            /* Uninitialized string variable = empty string */
-            result_buffer[0] = '\0';
-        }
-        else
-        {
-            strncpy(result_buffer, cell->value.str, 7);
-            result_buffer[7] = '\0';
-        }
+        /* Uninitialized string variable = empty string */
+        *result = var_cell_get_word(&g_program.vars[var_idx - 1]);
         return true;
     }
 
@@ -656,23 +734,9 @@ static bool eval_string_expression(uint8_t **pc_ptr, char *result_buffer)
         }
         (*pc_ptr)++; /* Skip T_ENDX */
 
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return false;
-        }
+        const VarCell *cell = vm_var_load(index_val);
 
-        VarCell *cell = &g_program.vars[index - 1];
-        if (cell->type != VAR_STR)
-        {
-            result_buffer[0] = '\0'; /* Empty string */
-        }
-        else
-        {
-            strncpy(result_buffer, cell->value.str, 7);
-            result_buffer[7] = '\0';
-        }
+        *result = var_cell_get_word(cell);
         return true;
     }
 
@@ -692,11 +756,11 @@ bool vm_eval_condition(uint8_t **pc_ptr, uint8_t *end)
     if (is_string_comparison)
     {
         /* String comparison */
-        char left_str[8];  /* 7 chars + null */
-        char right_str[8]; /* 7 chars + null */
+        StrWord left_str;
+        StrWord right_str;
 
         /* Evaluate left string */
-        if (!eval_string_expression(pc_ptr, left_str))
+        if (!eval_string_expression(pc_ptr, &left_str))
             return false;
 
         /* Get comparison operator - only = and <> supported for strings */
@@ -715,18 +779,17 @@ bool vm_eval_condition(uint8_t **pc_ptr, uint8_t *end)
         (*pc_ptr)++;
 
         /* Evaluate right string */
-        if (!eval_string_expression(pc_ptr, right_str))
+        if (!eval_string_expression(pc_ptr, &right_str))
             return false;
 
         /* Perform string comparison */
-        int cmp_result = strcmp(left_str, right_str);
         switch (op)
         {
         case T_EQ:
         case T_EQ_ASSIGN:
-            return cmp_result == 0;
+            return left_str == right_str;
         case T_NE:
-            return cmp_result != 0;
+            return left_str != right_str;
         default:
             vm_error_set(ERR_SYNTAX_ERROR);
             return false;
@@ -902,9 +965,7 @@ static void execute_var_assign(void)
         return;
     }
 
-    VarCell *cell = &g_program.vars[var_idx - 1];
-    cell->type = VAR_NUM;
-    cell->value.num = value;
+    vm_set_num(&g_program.vars[var_idx - 1], value);
 }
 
 static void execute_svar_assign(void)
@@ -938,27 +999,11 @@ static void execute_svar_assign(void)
         return;
     }
 
-    VarCell *cell = &g_program.vars[var_idx - 1];
-    cell->type = VAR_STR;
-
     /* Copy string data, convert to uppercase (up to STR_MAX chars) */
-    int i;
-    for (i = 0; i < copy_len; i++)
-    {
-        char c = *g_vm.pc++;
-        if (c >= 'a' && c <= 'z')
-        {
-            c = c - 'a' + 'A'; /* Convert to uppercase */
-        }
-        cell->value.str[i] = c;
-    }
-    cell->value.str[i] = '\0'; /* Null terminate */
+    var_cell_set_word(&g_program.vars[var_idx - 1], str_word_make((const char *)g_vm.pc, copy_len));
 
-    /* Skip remaining bytes if string was longer than STR_MAX */
-    for (int j = copy_len; j < orig_str_len; j++)
-    {
-        g_vm.pc++;
-    }
+    /* Skip all bytes, even if string was longer than STR_MAX */
+    g_vm.pc += orig_str_len;
 }
 
 static void execute_vidx_assign(void)
@@ -989,16 +1034,9 @@ static void execute_vidx_assign(void)
         return;
 
     /* Store in indexed variable */
-    int index = (int)index_val;
-    if (index < 1 || index > VARS_MAX)
-    {
-        vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-        return;
-    }
+    VarCell *cell = vm_var_store(index_val);
 
-    VarCell *cell = &g_program.vars[index - 1];
-    cell->type = VAR_NUM;
-    cell->value.num = value;
+    vm_set_num(cell, value);
 }
 
 static void execute_svidx_assign(void)
@@ -1030,35 +1068,13 @@ static void execute_svidx_assign(void)
     uint8_t orig_str_len = *g_vm.pc++;
     uint8_t copy_len = (orig_str_len > STR_MAX) ? STR_MAX : orig_str_len;
 
-    /* Convert index to integer */
-    int index = (int)index_val;
-    if (index < 1 || index > VARS_MAX)
-    {
-        vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-        return;
-    }
-
-    VarCell *cell = &g_program.vars[index - 1];
-    cell->type = VAR_STR;
+    VarCell *cell = vm_var_store(index_val);
 
     /* Copy string data, convert to uppercase (up to STR_MAX chars) */
-    int i;
-    for (i = 0; i < copy_len; i++)
-    {
-        char c = *g_vm.pc++;
-        if (c >= 'a' && c <= 'z')
-        {
-            c = c - 'a' + 'A'; /* Convert to uppercase */
-        }
-        cell->value.str[i] = c;
-    }
-    cell->value.str[i] = '\0'; /* Null terminate */
+    var_cell_set_word(cell, str_word_make((const char *)g_vm.pc, copy_len));
 
-    /* Skip remaining bytes if string was longer than STR_MAX */
-    for (int j = copy_len; j < orig_str_len; j++)
-    {
-        g_vm.pc++;
-    }
+    /* Skip all bytes, even if string was longer than STR_MAX */
+    g_vm.pc += orig_str_len;
 }
 
 static void execute_let(void)
@@ -1092,9 +1108,7 @@ static void execute_let(void)
             return;
         }
 
-        VarCell *cell = &g_program.vars[var_idx - 1];
-        cell->type = VAR_NUM;
-        cell->value.num = value;
+        vm_set_num(&g_program.vars[var_idx - 1], value);
     }
     else if (next_token == T_VIDX)
     {
@@ -1123,16 +1137,9 @@ static void execute_let(void)
             return;
 
         /* Store in indexed variable */
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
-        }
+        VarCell *cell = vm_var_store(index_val);
 
-        VarCell *cell = &g_program.vars[index - 1];
-        cell->type = VAR_NUM;
-        cell->value.num = value;
+        vm_set_num(cell, value);
     }
 }
 
@@ -1143,7 +1150,7 @@ static void print_expressions(void)
     {
         if (*g_vm.pc == T_COMMA || *g_vm.pc == T_SEMI)
         {
-            printf(" ");
+            output_char(' ');
             g_vm.pc++;
         }
         else if (*g_vm.pc == T_STR)
@@ -1151,10 +1158,8 @@ static void print_expressions(void)
             /* Handle string literals */
             g_vm.pc++; /* Skip T_STR */
             uint8_t str_len = *g_vm.pc++;
-            for (int i = 0; i < str_len; i++)
-            {
-                putchar(*g_vm.pc++);
-            }
+            output_bytes((const char *)g_vm.pc, str_len);
+            g_vm.pc += str_len;
         }
         else if (*g_vm.pc == T_SVAR)
         {
@@ -1166,16 +1171,11 @@ static void print_expressions(void)
                 vm_error_set(ERR_INDEX_OUT_OF_RANGE);
                 return;
             }
-            VarCell *cell = &g_program.vars[var_idx - 1];
-            if (cell->type == VAR_STR)
-            {
-                printf("%s", cell->value.str);
-            }
-            else
-            {
-                /* Print empty string for uninitialized string variables */
-                /* (PC-1211 behavior for uninitialized string vars) */
-            }
+            /* Uninitialized string variables print as the empty string */
+            /* (PC-1211 behavior for uninitialized string vars) */
+            char str[STR_MAX + 1];
+            str_word_get(var_cell_get_word(&g_program.vars[var_idx - 1]), str);
+            output_str(str);
         }
         else if (*g_vm.pc == T_SVIDX)
         {
@@ -1193,23 +1193,12 @@ static void print_expressions(void)
                 g_vm.pc++;
             }
 
-            /* Convert to integer index (truncate toward zero) */
-            int index = (int)index_val;
-            if (index < 1 || index > VARS_MAX)
-            {
-                vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-                return;
-            }
+            const VarCell *cell = vm_var_load(index_val);
 
-            VarCell *cell = &g_program.vars[index - 1];
-            if (cell->type == VAR_STR)
-            {
-                printf("%s", cell->value.str);
-            }
-            else
-            {
-                /* Print empty string for uninitialized string variables */
-            }
+            /* Uninitialized string variables print as the empty string */
+            char str[STR_MAX + 1];
+            str_word_get(var_cell_get_word(cell), str);
+            output_str(str);
         }
         else
         {
@@ -1217,10 +1206,10 @@ static void print_expressions(void)
             double value = vm_eval_expression_auto(&g_vm.pc);
             if (error_get_code() != ERR_NONE)
                 return;
-            printf("%g", value);
+            output_number(value);
         }
     }
-    printf("\n");
+    output_char('\n');
 }
 
 static void execute_print(void)
@@ -1247,9 +1236,7 @@ static void execute_goto(void)
             vm_error_set(ERR_SYNTAX_ERROR);
             return;
         }
-        char label[STR_MAX + 1];
-        memcpy(label, g_vm.pc, str_len);
-        label[str_len] = '\0';
+        StrWord label = str_word_make((const char *)g_vm.pc, str_len);
         g_vm.pc += str_len;
 
         vm_goto_label(label);
@@ -1264,13 +1251,13 @@ static void execute_goto(void)
         VarCell *cell = var_get(var_idx);
         assert(cell); /* var_get never returns NULL - it calls error_report which never returns */
 
-        if (cell->type != VAR_STR)
+        if (!var_is_str(cell))
         {
             vm_error_set(ERR_TYPE_MISMATCH);
             return;
         }
 
-        vm_goto_label(cell->value.str);
+        vm_goto_label(var_cell_get_word(cell));
     }
     else
     {
@@ -1279,7 +1266,7 @@ static void execute_goto(void)
         if (error_get_code() != ERR_NONE)
             return;
 
-        vm_goto_line((uint16_t)line_num);
+        vm_goto_line(line_num);
     }
     /* Don't advance PC normally - handled by return */
 }
@@ -1296,8 +1283,8 @@ static void execute_stop(void)
 
 static void execute_gosub(void)
 {
-    /* Capture current position for return */
-    VMPosition return_pos = vm_capture_position();
+    /* Return position, captured once the target has been parsed */
+    VMPosition return_pos;
 
     /* Check if next token is a string label (literal or variable) */
     if (*g_vm.pc == T_STR)
@@ -1310,16 +1297,14 @@ static void execute_gosub(void)
             vm_error_set(ERR_SYNTAX_ERROR);
             return;
         }
-        char label[STR_MAX + 1];
-        memcpy(label, g_vm.pc, str_len);
-        label[str_len] = '\0';
+        StrWord label = str_word_make((const char *)g_vm.pc, str_len);
         g_vm.pc += str_len;
 
         /* Update return position to point after the label */
-        return_pos.pc = g_vm.pc;
+        return_pos = vm_capture_position();
 
         /* Push return address onto call stack */
-        vm_push_call(return_pos);
+        vm_push_gosub_return(return_pos);
         if (error_get_code() != ERR_NONE)
             return;
 
@@ -1332,24 +1317,24 @@ static void execute_gosub(void)
         uint8_t var_idx = *g_vm.pc++;
 
         /* Update return position to point after the variable */
-        return_pos.pc = g_vm.pc;
+        return_pos = vm_capture_position();
 
         /* Get string variable value */
         VarCell *cell = var_get(var_idx);
         assert(cell); /* var_get never returns NULL - it calls error_report which never returns */
 
-        if (cell->type != VAR_STR)
+        if (!var_is_str(cell))
         {
             vm_error_set(ERR_TYPE_MISMATCH);
             return;
         }
 
         /* Push return address onto call stack */
-        vm_push_call(return_pos);
+        vm_push_gosub_return(return_pos);
         if (error_get_code() != ERR_NONE)
             return;
 
-        vm_goto_label(cell->value.str);
+        vm_goto_label(var_cell_get_word(cell));
     }
     else
     {
@@ -1359,14 +1344,14 @@ static void execute_gosub(void)
             return;
 
         /* Update return position to point after the expression */
-        return_pos.pc = g_vm.pc;
+        return_pos = vm_capture_position();
 
         /* Push return address onto call stack */
-        vm_push_call(return_pos);
+        vm_push_gosub_return(return_pos);
         if (error_get_code() != ERR_NONE)
             return;
 
-        vm_goto_line((uint16_t)line_num);
+        vm_goto_line(line_num);
     }
     /* Don't advance PC normally - handled by jump */
 }
@@ -1444,14 +1429,10 @@ static void execute_for(void)
         vm_error_set(ERR_INDEX_OUT_OF_RANGE);
         return;
     }
-    VarCell *cell = &g_program.vars[var_idx - 1];
-    cell->type = VAR_NUM;
-    cell->value.num = start_val;
+    vm_set_num(&g_program.vars[var_idx - 1], start_val);
 
     /* We always jump back exactly here */
-    VMPosition body;
-    body.line_ptr = g_vm.current_line_ptr;
-    body.pc = g_vm.pc;
+    VMPosition body = vm_capture_position();
 
     vm_push_for(body, var_idx, limit_val, step_val);
     if (error_get_code() != ERR_NONE)
@@ -1487,14 +1468,14 @@ static void execute_next(void)
         }
 
         /* Get frame data */
-        ForFrame *frame = &g_vm.for_stack.frames[frame_index];
+        ForFrame *frame = &g_vm.for_frames[frame_index];
         body_pos = frame->body;
         frame_var_idx = frame->var_idx;
         limit = frame->limit;
         step = frame->step;
 
         /* Remove this frame and all frames above it */
-        g_vm.for_stack.top = frame_index;
+        g_vm.for_top = frame_index;
     }
     else
     {
@@ -1512,22 +1493,22 @@ static void execute_next(void)
         return;
     }
     VarCell *cell = &g_program.vars[frame_var_idx - 1];
-    if (cell->type != VAR_NUM)
+    if (var_is_str(cell))
     {
         vm_error_set(ERR_TYPE_MISMATCH);
         return;
     }
-    cell->value.num += step;
+    vm_set_num(cell, cell->num + step);
 
     /* Check loop condition */
     bool continue_loop;
     if (step > 0)
     {
-        continue_loop = (cell->value.num <= limit);
+        continue_loop = (cell->num <= limit);
     }
     else
     {
-        continue_loop = (cell->value.num >= limit);
+        continue_loop = (cell->num >= limit);
     }
 
     if (continue_loop)
@@ -1545,122 +1526,60 @@ static void execute_next(void)
     /* Loop finished - continue to next statement */
 }
 
-static void execute_input(void)
+/* Read one INPUT record into a cell, as a string or a number */
+static void vm_input(VarCell *cell, bool is_string)
 {
-    /* INPUT variable - read value from user */
-    if (*g_vm.pc == T_VAR)
-    {
-        /* Numeric variable */
-        g_vm.pc++; /* Skip T_VAR */
-        uint8_t var_idx = *g_vm.pc++;
-
-        if (var_idx < 1 || var_idx > 26)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
-        }
+    output_str("? ");
+    if (input_is_interactive())
+        output_flush(); /* The output so far must be visible before reading */
 
-        printf("? ");
-        fflush(stdout);
-
-        char input[100];
-        if (fgets(input, sizeof(input), stdin))
-        {
-            double value = atof(input);
-            VarCell *cell = &g_program.vars[var_idx - 1];
-            cell->type = VAR_NUM;
-            cell->value.num = value;
-        }
-    }
-    else if (*g_vm.pc == T_SVAR)
+    const char *text;
+    uint32_t len;
+    if (!input_next_record(&text, &len))
     {
-        /* String variable */
-        g_vm.pc++; /* Skip T_SVAR */
-        uint8_t var_idx = *g_vm.pc++;
-
-        if (var_idx < 1 || var_idx > 26)
+        switch (input_eof_policy())
         {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
+        case INPUT_EOF_KEEP:
+            break;
+        case INPUT_EOF_END:
+            g_vm.running = false;
+            break;
+        case INPUT_EOF_ERROR:
+            vm_error_set(ERR_INPUT_END);
+            break;
         }
+        return;
+    }
 
-        printf("? ");
-        fflush(stdout);
-
-        char input[100];
-        if (fgets(input, sizeof(input), stdin))
-        {
-            /* Remove newline if present */
-            int len = strlen(input);
-            if (len > 0 && input[len - 1] == '\n')
-            {
-                input[len - 1] = '\0';
-                len--;
-            }
-
-            /* Limit to 7 characters and convert to uppercase */
-            if (len > STR_MAX)
-            {
-                len = STR_MAX;
-            }
+    if (is_string)
+        var_cell_set_word(cell, str_word_make(text, (int)len)); /* Limit to 7 characters, uppercase */
+    else
+        vm_set_num(cell, input_parse_num(text, len));
+}
 
-            VarCell *cell = &g_program.vars[var_idx - 1];
-            cell->type = VAR_STR;
+static void execute_input(void)
+{
+    /* INPUT variable - read value from user */
+    bool is_string = *g_vm.pc == T_SVAR || *g_vm.pc == T_SVIDX;
+    VarCell *cell;
 
-            int i;
-            for (i = 0; i < len; i++)
-            {
-                char c = input[i];
-                if (c >= 'a' && c <= 'z')
-                {
-                    c = c - 'a' + 'A'; /* Convert to uppercase */
-                }
-                cell->value.str[i] = c;
-            }
-            cell->value.str[i] = '\0';
-        }
-    }
-    else if (*g_vm.pc == T_VIDX)
+    if (*g_vm.pc == T_VAR || *g_vm.pc == T_SVAR)
     {
-        /* Indexed numeric variable */
-        g_vm.pc++; /* Skip T_VIDX */
-        g_vm.pc++; /* Skip placeholder byte */
-
-        /* Evaluate index expression */
-        double index_val = vm_eval_expression_auto(&g_vm.pc);
-        if (error_get_code() != ERR_NONE)
-            return;
-
-        /* Skip T_ENDX terminator */
-        if (*g_vm.pc == T_ENDX)
-        {
-            g_vm.pc++;
-        }
+        /* Simple variable */
+        g_vm.pc++; /* Skip T_VAR/T_SVAR */
+        uint8_t var_idx = *g_vm.pc++;
 
-        /* Convert to integer index */
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
+        if (var_idx < 1 || var_idx > 26)
         {
             vm_error_set(ERR_INDEX_OUT_OF_RANGE);
             return;
         }
-
-        printf("? ");
-        fflush(stdout);
-
-        char input[100];
-        if (fgets(input, sizeof(input), stdin))
-        {
-            double value = atof(input);
-            VarCell *cell = &g_program.vars[index - 1];
-            cell->type = VAR_NUM;
-            cell->value.num = value;
-        }
+        cell = &g_program.vars[var_idx - 1];
     }
-    else if (*g_vm.pc == T_SVIDX)
+    else if (*g_vm.pc == T_VIDX || *g_vm.pc == T_SVIDX)
     {
-        /* Indexed string variable */
-        g_vm.pc++; /* Skip T_SVIDX */
+        /* Indexed variable */
+        g_vm.pc++; /* Skip T_VIDX/T_SVIDX */
         g_vm.pc++; /* Skip placeholder byte */
 
         /* Evaluate index expression */
@@ -1673,56 +1592,15 @@ static void execute_input(void)
         {
             g_vm.pc++;
         }
-
-        /* Convert to integer index */
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
-        }
-
-        printf("? ");
-        fflush(stdout);
-
-        char input[100];
-        if (fgets(input, sizeof(input), stdin))
-        {
-            /* Remove newline if present */
-            int len = strlen(input);
-            if (len > 0 && input[len - 1] == '\n')
-            {
-                input[len - 1] = '\0';
-                len--;
-            }
-
-            /* Limit to 7 characters and convert to uppercase */
-            if (len > STR_MAX)
-            {
-                len = STR_MAX;
-            }
-
-            VarCell *cell = &g_program.vars[index - 1];
-            cell->type = VAR_STR;
-
-            int i;
-            for (i = 0; i < len; i++)
-            {
-                char c = input[i];
-                if (c >= 'a' && c <= 'z')
-                {
-                    c = c - 'a' + 'A'; /* Convert to uppercase */
-                }
-                cell->value.str[i] = c;
-            }
-            cell->value.str[i] = '\0';
-        }
+        cell = vm_var_store(index_val);
     }
     else
     {
         vm_error_set(ERR_SYNTAX_ERROR);
         return;
     }
+
+    vm_input(cell, is_string);
 }
 
 static void execute_aread(void)
@@ -1741,15 +1619,14 @@ static void execute_aread(void)
         }
 
         VarCell *cell = &g_program.vars[var_idx - 1];
-        cell->type = VAR_NUM;
         if (g_vm.aread_is_string)
         {
             /* Convert string to number */
-            cell->value.num = atof(g_vm.aread_string);
+            vm_set_num(cell, atof(g_vm.aread_string));
         }
         else
         {
-            cell->value.num = g_vm.aread_value;
+            vm_set_num(cell, g_vm.aread_value);
         }
         /* Clear AREAD after use */
         g_vm.aread_value = 0.0;
@@ -1769,18 +1646,18 @@ static void execute_aread(void)
         }
 
         VarCell *cell = &g_program.vars[var_idx - 1];
-        cell->type = VAR_STR;
 
         if (g_vm.aread_is_string)
         {
             /* Use string directly */
-            strncpy(cell->value.str, g_vm.aread_string, sizeof(cell->value.str) - 1);
-            cell->value.str[sizeof(cell->value.str) - 1] = '\0';
+            var_cell_set_word(cell, str_word_make(g_vm.aread_string, strlen(g_vm.aread_string)));
         }
         else
         {
-            /* Convert numeric value to string */
-            snprintf(cell->value.str, sizeof(cell->value.str), "%.6g", g_vm.aread_value);
+            /* Convert numeric value to string (truncated to STR_MAX) */
+            char str[32];
+            snprintf(str, sizeof(str), "%.6g", g_vm.aread_value);
+            var_cell_set_word(cell, str_word_make(str, strlen(str)));
         }
         /* Clear AREAD after use */
         g_vm.aread_value = 0.0;
@@ -1804,24 +1681,16 @@ static void execute_aread(void)
             g_vm.pc++;
         }
 
-        /* Convert to integer index */
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
-        }
+        VarCell *cell = vm_var_store(index_val);
 
-        VarCell *cell = &g_program.vars[index - 1];
-        cell->type = VAR_NUM;
         if (g_vm.aread_is_string)
         {
             /* Convert string to number */
-            cell->value.num = atof(g_vm.aread_string);
+            vm_set_num(cell, atof(g_vm.aread_string));
         }
         else
         {
-            cell->value.num = g_vm.aread_value;
+            vm_set_num(cell, g_vm.aread_value);
         }
         /* Clear AREAD after use */
         g_vm.aread_value = 0.0;
@@ -1845,27 +1714,19 @@ static void execute_aread(void)
             g_vm.pc++;
         }
 
-        /* Convert to integer index */
-        int index = (int)index_val;
-        if (index < 1 || index > VARS_MAX)
-        {
-            vm_error_set(ERR_INDEX_OUT_OF_RANGE);
-            return;
-        }
-
-        VarCell *cell = &g_program.vars[index - 1];
-        cell->type = VAR_STR;
+        VarCell *cell = vm_var_store(index_val);
 
         if (g_vm.aread_is_string)
         {
             /* Use string directly */
-            strncpy(cell->value.str, g_vm.aread_string, sizeof(cell->value.str) - 1);
-            cell->value.str[sizeof(cell->value.str) - 1] = '\0';
+            var_cell_set_word(cell, str_word_make(g_vm.aread_string, strlen(g_vm.aread_string)));
         }
         else
         {
-            /* Convert numeric value to string */
-            snprintf(cell->value.str, sizeof(cell->value.str), "%.6g", g_vm.aread_value);
+            /* Convert numeric value to string (truncated to STR_MAX) */
+            char str[32];
+            snprintf(str, sizeof(str), "%.6g", g_vm.aread_value);
+            var_cell_set_word(cell, str_word_make(str, strlen(str)));
         }
         /* Clear AREAD after use */
         g_vm.aread_value = 0.0;
@@ -1896,27 +1757,24 @@ static void execute_grad(void)
 
 static void execute_clear(void)
 {
-    /* Clear all variables A-Z and indexed variables A(1) through A(VARS_MAX) */
-    for (int i = 0; i <= VARS_MAX; i++)
-    {
-        g_program.vars[i].type = VAR_NUM;
-        g_program.vars[i].value.num = 0.0;
-    }
+    /* Clear all variables A-Z and indexed variables A(1) through A(vars_max) */
+    var_init_all();
 }
 
 static void execute_beep(void)
 {
-    putchar('\a'); /* ASCII bell character */
-    fflush(stdout);
+    output_char('\a'); /* ASCII bell character */
+    if (vclock_mode() != VCLOCK_INSTANT)
+        output_flush(); /* Heard while it sounds */
+    vclock_tone(BEEP_USEC);
 }
 
 static void execute_pause(void)
 {
-    /* PAUSE works exactly like PRINT, then waits 100ms */
+    /* PAUSE works exactly like PRINT, then shows the line for a while */
     print_expressions();
-
-    /* Wait 100ms */
-    usleep(100000); /* 100,000 microseconds = 100ms */
+    output_flush();
+    vclock_wait(PAUSE_USEC);
 
     /* PAUSE clears AREAD after displaying */
     g_vm.aread_value = 0.0;
@@ -1978,8 +1836,8 @@ static void execute_if(void)
             if (*g_vm.pc == T_STR || *g_vm.pc == T_SVAR || *g_vm.pc == T_SVIDX)
             {
                 /* String label - evaluate and look up */
-                char label_str[8]; /* 7 chars + null */
-                if (!eval_string_expression(&g_vm.pc, label_str))
+                StrWord label_str;
+                if (!eval_string_expression(&g_vm.pc, &label_str))
                     return;
 
                 vm_goto_label(label_str);
@@ -1991,7 +1849,7 @@ static void execute_if(void)
                 if (error_get_code() != ERR_NONE)
                     return;
 
-                vm_goto_line((int)line_num);
+                vm_goto_line(line_num);
             }
         }
         else
@@ -2031,6 +1889,9 @@ void vm_run(void)
     /* Clear any previous errors */
     error_clear();
 
+    /* Stacks whose depth the load-time analysis could not bound are checked on push */
+    vm_size_stacks(g_program.call_depth, g_program.for_depth);
+
     /* Start at first line */
     vm_start_program();
     if (!g_vm.running)
@@ -2039,16 +1900,20 @@ void vm_run(void)
         return;
     }
 
-    /* Main execution loop */
-    while (g_vm.running && !program_is_last_line(g_vm.current_line_ptr))
+    /* Main execution loop. Past the last line loaded so far, a streamed
+     * program waits for the next one: it is appended at the terminator, where
+     * vm_next_line() has already put the PC */
+    while (g_vm.running && !program_at_end(g_vm.current_line_ptr))
     {
         vm_execute_statement();
     }
 
+    output_flush();
     return;
 
 vm_error_handler:
     /* Error occurred during execution - print and return */
+    output_flush();
     error_print();
 }
 
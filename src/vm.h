@@ -4,37 +4,25 @@
 #include "opcodes.h"
 #include "program.h"
 #include <stdbool.h>
+#include <stddef.h>
 
-/* VM position for capturing and restoring PC+line state */
+/* VM position for capturing and restoring PC+line state.
+ * Stored as offsets into g_program.prog, so saved positions stay valid if the
+ * image is moved, and a suspended VM can be saved without pointer fixups */
 typedef struct
 {
-    uint8_t *line_ptr; //  Start of the line
-    uint8_t *pc;       //  PC
+    uint32_t line_off; //  Start of the line
+    uint32_t pc_off;   //  PC
 } VMPosition;
 
-/* Expression evaluation stack */
-#define EXPR_STACK_SIZE 32
+/* GOSUB/RETURN call stack frame.
+ * Expressions are evaluated by recursive descent and need no value stack */
 typedef struct
 {
-    double values[EXPR_STACK_SIZE];
-    int top;
-} ExprStack;
-
-/* GOSUB/RETURN call stack */
-#define CALL_STACK_SIZE 16
-typedef struct
-{
-    VMPosition return_pos; /* Where to return to */
+    uint32_t return_pc; /* Where to return to, as an offset into g_program.prog (past 64 KB with --extended) */
 } CallFrame;
 
-typedef struct
-{
-    CallFrame frames[CALL_STACK_SIZE];
-    int top;
-} CallStack;
-
-/* FOR/NEXT loop stack */
-#define FOR_STACK_SIZE 16
+/* FOR/NEXT loop stack frame */
 typedef struct
 {
     VMPosition body; /* Position after the FOR statement */
@@ -43,12 +31,6 @@ typedef struct
     double step;     /* STEP value */
 } ForFrame;
 
-typedef struct
-{
-    ForFrame frames[FOR_STACK_SIZE];
-    int top;
-} ForStack;
-
 /* Angle modes for trigonometric functions */
 typedef enum
 {
@@ -57,25 +39,51 @@ typedef enum
     ANGLE_GRAD = 2
 } AngleMode;
 
-/* VM state */
+/* Stack storage, shared by the two stacks: FOR frames from its start, GOSUB
+ * frames after them. It holds the 16 + 16 frames of the default split; a
+ * depth bound proven at load time takes exactly its frames and leaves the
+ * rest to the other stack (see vm_size_stacks()) */
+enum
+{
+    VM_CALL_FRAMES = 16, /* Default split */
+    VM_FOR_FRAMES = 16,
+    VM_STACK_BYTES = VM_CALL_FRAMES * sizeof(CallFrame) + VM_FOR_FRAMES * sizeof(ForFrame)
+};
+
+/* Cache line size the hot part of VM is packed into */
+#define VM_CACHE_LINE 64
+
+/* VM state.
+ * Fields read on every token or statement come first and must fit in one
+ * cache line (checked in vm_init); stack storage and AREAD state follow */
 typedef struct
 {
-    bool running;              /* VM running state */
+    /* Hot */
     uint8_t *pc;               /* Program counter (token pointer) */
     uint8_t *current_line_ptr; /* Current line pointer */
-    ExprStack expr_stack;      /* Expression evaluation stack */
-    CallStack call_stack;      /* GOSUB/RETURN call stack */
-    ForStack for_stack;        /* FOR/NEXT loop stack */
+    CallFrame *call_frames;    /* GOSUB/RETURN call stack, call_max frames */
+    ForFrame *for_frames;      /* FOR/NEXT loop stack, for_max frames */
+    int call_top;              /* GOSUB/RETURN stack depth */
+    int for_top;               /* FOR/NEXT stack depth */
+    int call_max;
+    int for_max;
+    AngleMode angle_mode;      /* Trigonometric angle mode */
+    bool running;              /* VM running state */
+    bool call_checked;         /* GOSUB depth not proven at load time: check pushes */
+    bool for_checked;          /* FOR depth not proven at load time: check pushes */
+
+    /* Cold: stack storage, only touched at the top-of-stack slot */
+    ForFrame stack_storage[VM_STACK_BYTES / sizeof(ForFrame)];
 
-    /* AREAD state */
+    /* Cold: AREAD state */
     char aread_string[8]; /* AREAD string value */
     double aread_value;   /* AREAD numeric value */
     bool aread_is_string; /* Whether AREAD value is a string */
-
-    /* Modes */
-    AngleMode angle_mode; /* Trigonometric angle mode */
 } VM;
 
+/* Offset of the first cold field; everything before it is hot */
+#define VM_HOT_END offsetof(VM, stack_storage)
+
 /* VM initialization and control */
 void vm_init(void);
 void vm_run(void);
@@ -88,8 +96,6 @@ void vm_error_if(bool condition, ErrorCode code);
 
 /* Expression evaluation */
 double vm_eval_expression_auto(uint8_t **pc_ptr); /* Token-aware, no boundaries */
-void vm_push_value(double value);
-double vm_pop_value(void);
 
 /* Comparison operations for IF */
 bool vm_eval_condition(uint8_t **pc_ptr, uint8_t *end);
@@ -5,10 +5,16 @@ PC-1211 BASIC Test Harness
 This test harness runs all .bas files in the tests/ directory and creates
 reference outputs for regression testing. It automatically classifies tests
 as expected to pass or fail based on naming patterns and exit codes.
+A test that needs interpreter options lists them in a .args file of the same
+name (e.g. tests/foo_pass.args next to tests/foo_pass.bas), and a test that
+reads standard input has it in a .in file. Each line of a .args file is one
+run of the interpreter, the last one giving the result; {image} in it names a
+program image kept between the runs of the test.
 """
 
 import os
 import subprocess
+import tempfile
 import sys
 import json
 import hashlib
@@ -116,6 +122,25 @@ class TestHarness:
         """Find all .bas test files"""
         return sorted(self.tests_dir.glob("*.bas"))
     
+    def test_commands(self, test_file: Path, scratch: str) -> List[List[str]]:
+        """Interpreter runs of a test, one per line of its .args file if any.
+        A run that loads an image goes without the source file"""
+        args_file = test_file.with_suffix(".args")
+        lines = args_file.read_text().splitlines() if args_file.exists() else []
+        commands = []
+        for line in [line for line in lines if line.strip()] or [""]:
+            args = [arg.replace("{image}", os.path.join(scratch, "image.pcb")) for arg in line.split()]
+            source = [] if "--load-image" in args else [str(test_file)]
+            commands.append([str(self.pc1211_path)] + source + ["--run"] + args)
+        return commands
+
+    def test_input(self, test_file: Path) -> Optional[str]:
+        """Standard input of a test, from its .in file if any"""
+        input_file = test_file.with_suffix(".in")
+        if not input_file.exists():
+            return None
+        return input_file.read_text()
+    
     def run_single_test(self, test_file: Path) -> TestResult:
         """Run a single test file and capture results"""
         import time
@@ -125,12 +150,18 @@ class TestHarness:
         
         start_time = time.time()
         try:
-            result = subprocess.run(
-                [str(self.pc1211_path), str(test_file), "--run"],
-                capture_output=True,
-                text=True,
-                timeout=0.5  # 500ms timeout for faster testing
-            )
+            with tempfile.TemporaryDirectory() as scratch:
+                for command in self.test_commands(test_file, scratch):
+                    result = subprocess.run(
+                        command,
+                        input=self.test_input(test_file),
+                        capture_output=True,
+                        text=True,
+                        errors="replace",  # A binary variable dump is not text
+                        timeout=0.5  # 500ms timeout for faster testing
+                    )
+                    if result.returncode != 0:
+                        break  # A failed earlier run is the result
             execution_time = time.time() - start_time
             
             test_result = TestResult(
@@ -0,0 +1,7 @@
+10 REM OUTPUT WRITTEN BY THE WRITER THREAD STAYS IN ORDER
+20 FOR I=1 TO 1500
+30 PRINT "FROM THE WRITER THREAD, LINE ";I
+40 NEXT I
+50 BEEP
+60 PAUSE "PAUSE HANDS OVER"
+70 PRINT "PASS: ASYNC OUTPUT COMPLETE"
@@ -0,0 +1,201 @@
+1 REM 4 byte line headers
+2 C=A
+3 C=A
+4 C=A
+5 C=A
+6 C=A
+7 C=A
+8 C=A
+9 C=A
+10 C=A
+11 C=A
+12 C=A
+13 C=A
+14 C=A
+15 C=A
+16 C=A
+17 C=A
+18 C=A
+19 C=A
+20 C=A
+21 C=A
+22 C=A
+23 C=A
+24 C=A
+25 C=A
+26 C=A
+27 C=A
+28 C=A
+29 C=A
+30 C=A
+31 C=A
+32 C=A
+33 C=A
+34 C=A
+35 C=A
+36 C=A
+37 C=A
+38 C=A
+39 C=A
+40 C=A
+41 C=A
+42 C=A
+43 C=A
+44 C=A
+45 C=A
+46 C=A
+47 C=A
+48 C=A
+49 C=A
+50 C=A
+51 C=A
+52 C=A
+53 C=A
+54 C=A
+55 C=A
+56 C=A
+57 C=A
+58 C=A
+59 C=A
+60 C=A
+61 C=A
+62 C=A
+63 C=A
+64 C=A
+65 C=A
+66 C=A
+67 C=A
+68 C=A
+69 C=A
+70 C=A
+71 C=A
+72 C=A
+73 C=A
+74 C=A
+75 C=A
+76 C=A
+77 C=A
+78 C=A
+79 C=A
+80 C=A
+81 C=A
+82 C=A
+83 C=A
+84 C=A
+85 C=A
+86 C=A
+87 C=A
+88 C=A
+89 C=A
+90 C=A
+91 C=A
+92 C=A
+93 C=A
+94 C=A
+95 C=A
+96 C=A
+97 C=A
+98 C=A
+99 C=A
+100 C=A
+101 C=A
+102 C=A
+103 C=A
+104 C=A
+105 C=A
+106 C=A
+107 C=A
+108 C=A
+109 C=A
+110 C=A
+111 C=A
+112 C=A
+113 C=A
+114 C=A
+115 C=A
+116 C=A
+117 C=A
+118 C=A
+119 C=A
+120 C=A
+121 C=A
+122 C=A
+123 C=A
+124 C=A
+125 C=A
+126 C=A
+127 C=A
+128 C=A
+129 C=A
+130 C=A
+131 C=A
+132 C=A
+133 C=A
+134 C=A
+135 C=A
+136 C=A
+137 C=A
+138 C=A
+139 C=A
+140 C=A
+141 C=A
+142 C=A
+143 C=A
+144 C=A
+145 C=A
+146 C=A
+147 C=A
+148 C=A
+149 C=A
+150 C=A
+151 C=A
+152 C=A
+153 C=A
+154 C=A
+155 C=A
+156 C=A
+157 C=A
+158 C=A
+159 C=A
+160 C=A
+161 C=A
+162 C=A
+163 C=A
+164 C=A
+165 C=A
+166 C=A
+167 C=A
+168 C=A
+169 C=A
+170 C=A
+171 C=A
+172 C=A
+173 C=A
+174 C=A
+175 C=A
+176 C=A
+177 C=A
+178 C=A
+179 C=A
+180 C=A
+181 C=A
+182 C=A
+183 C=A
+184 C=A
+185 C=A
+186 C=A
+187 C=A
+188 C=A
+189 C=A
+190 C=A
+191 C=A
+192 C=A
+193 C=A
+194 C=A
+195 C=A
+196 C=A
+197 C=A
+198 C=A
+199 C=A
+200 C=A
+201 PRINT "PASS: 200 LINES FIT"
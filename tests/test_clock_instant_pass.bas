@@ -0,0 +1,6 @@
+10 REM --CLOCK INSTANT: PAUSE AND BEEP TAKE NO REAL TIME, 4 S ON THE DEVICE
+20 FOR I=1 TO 20
+30 BEEP
+40 PAUSE "PAUSE ";I
+50 NEXT I
+60 PRINT "PASS: INSTANT CLOCK"
@@ -0,0 +1,2 @@
+10 REM --CLOCK-SCALE BELOW ZERO IS REFUSED BEFORE THE RUN
+20 PRINT "RUN STARTED"
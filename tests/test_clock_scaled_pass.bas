@@ -0,0 +1,5 @@
+10 REM --CLOCK-SCALE 0.01: 2 S OF PAUSES WAIT 20 MS
+20 FOR I=1 TO 20
+30 PAUSE "PAUSE ";I
+40 NEXT I
+50 PRINT "PASS: SCALED CLOCK"
@@ -0,0 +1,6 @@
+10 REM NUMBERS PRINT WITH A 10 DIGIT MANTISSA; THE DISPLAY'S EXPONENT FORM READS BACK
+20 A=1.5E 12 : B=1.5E12
+30 IF A<>B PRINT "FAIL: BLANK EXPONENT SIGN" : END
+40 IF 2.5E-3<>0.0025 PRINT "FAIL: NEGATIVE EXPONENT" : END
+50 PRINT 1/3;" ";-2/3;" ";A;" ";1E-12;" ";123456789*100
+60 PRINT "PASS: DISPLAY FORMAT"
@@ -0,0 +1,5 @@
+10 REM --DUMP-VARS=BIN TO ANOTHER FILE DESCRIPTOR THAN THE OUTPUT
+20 A=1.5
+30 B$="HI"
+40 C=-25E-3
+50 PRINT "PASS: VARIABLES SET FOR THE BINARY DUMP"
@@ -0,0 +1,3 @@
+10 REM --DUMP-FD TO A FILE DESCRIPTOR THAT IS NOT OPEN: THE RUN FAILS
+20 A=1.5
+30 PRINT "VARIABLES SET"
@@ -0,0 +1,41 @@
+10 REM 18 NESTED FOR LOOPS: THE PROVEN BOUND TAKES THE STACK STORAGE
+20 Z=0
+30 FOR A=1 TO 1
+31 FOR B=1 TO 1
+32 FOR C=1 TO 1
+33 FOR D=1 TO 1
+34 FOR E=1 TO 1
+35 FOR F=1 TO 1
+36 FOR G=1 TO 1
+37 FOR H=1 TO 1
+38 FOR I=1 TO 1
+39 FOR J=1 TO 1
+40 FOR K=1 TO 1
+41 FOR L=1 TO 1
+42 FOR M=1 TO 1
+43 FOR N=1 TO 1
+44 FOR O=1 TO 1
+45 FOR P=1 TO 1
+46 FOR Q=1 TO 1
+47 FOR R=1 TO 1
+50 Z=Z+1
+60 NEXT R
+61 NEXT Q
+62 NEXT P
+63 NEXT O
+64 NEXT N
+65 NEXT M
+66 NEXT L
+67 NEXT K
+68 NEXT J
+69 NEXT I
+70 NEXT H
+71 NEXT G
+72 NEXT F
+73 NEXT E
+74 NEXT D
+75 NEXT C
+76 NEXT B
+77 NEXT A
+80 IF Z<>1 PRINT "FAIL: BODY RAN ";Z;" TIMES" : END
+90 PRINT "PASS: 18 NESTED FOR LOOPS"
@@ -0,0 +1,10 @@
+10 REM NESTED SUBROUTINES DEEPER THAN 16 LEVELS
+20 N=0 : D=0
+30 GOSUB 100
+40 IF D<>20 PRINT "FAIL: UNWOUND ";D;" LEVELS" : END
+50 PRINT "PASS: 20 NESTED GOSUBS"
+60 END
+100 N=N+1
+110 IF N<20 GOSUB 100
+120 D=D+1
+130 RETURN
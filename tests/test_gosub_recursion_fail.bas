@@ -0,0 +1,8 @@
+10 REM UNBOUNDED RECURSION OVERFLOWS THE GOSUB STACK
+20 N=0
+30 GOSUB 100
+40 PRINT "FAIL: RETURNED"
+50 END
+100 N=N+1
+110 GOSUB 100 : N=N-1
+120 RETURN
@@ -0,0 +1,15 @@
+10 REM TAIL CALLS DO NOT GROW THE GOSUB STACK
+20 N=40
+30 GOSUB 100
+40 IF N<>0 PRINT "FAIL: LINE TAIL CALL" : END
+50 N=40
+60 GOSUB 200
+70 IF N<>0 PRINT "FAIL: COLON TAIL CALL" : END
+80 PRINT "PASS: TAIL CALLS REUSED THE FRAME"
+90 END
+100 N=N-1
+110 IF N>0 GOSUB 100
+120 RETURN
+200 N=N-1
+210 IF N=0 RETURN
+220 GOSUB 200 : RETURN
@@ -0,0 +1,2 @@
+10 REM SOURCE OF TEST_IMAGE_CHECKSUM_FAIL.PCB: ITS IMAGE WITH A CHANGED BYTE, SAME CHECKSUM
+20 PRINT "CHECKSUM IGNORED"
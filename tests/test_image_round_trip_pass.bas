@@ -0,0 +1,11 @@
+10 REM SAVED AS AN IMAGE, THEN RUN FROM IT: THE SAME PROGRAM
+20 "START" A$="ROUND":B=1.25E-7:C=123456
+30 GOSUB "SUB"
+40 FOR I=1 TO 3:D=D+I:NEXT I
+50 IF A$<>"ROUND" GOTO 100
+60 IF B<>1.25E-7 GOTO 100
+70 IF C+D<>123462 GOTO 100
+80 IF E<>2 GOTO 100
+90 PRINT "PASS: IMAGE ROUND TRIP":END
+100 PRINT "FAIL: IMAGE ROUND TRIP":END
+110 "SUB" E=E+2:RETURN
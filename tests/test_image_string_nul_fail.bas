@@ -0,0 +1,2 @@
+10 REM SOURCE OF TEST_IMAGE_STRING_NUL_FAIL.PCB: ITS IMAGE WITH A NUL IN THE STRING, RESUMMED
+20 PRINT "NUL ACCEPTED"
@@ -0,0 +1,8 @@
+10 REM --INPUT-EOF END: THE RUN STOPS AT THE INPUT PAST THE LAST VALUE
+20 INPUT A
+30 PRINT
+40 IF A<>5 THEN 80
+50 PRINT "PASS: LAST VALUE READ"
+60 INPUT B
+70 Z=1/0
+80 PRINT "FAIL: INPUT VALUE"
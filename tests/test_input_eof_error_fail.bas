@@ -0,0 +1,4 @@
+10 REM --INPUT-EOF ERROR: INPUT PAST THE LAST VALUE IS AN ERROR
+20 INPUT A
+30 INPUT B
+40 PRINT "INPUT WENT ON"
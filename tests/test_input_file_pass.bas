@@ -0,0 +1,13 @@
+10 REM INPUT FROM A FILE, ONE VALUE PER LINE, LEADING BLANKS AND TABS SKIPPED
+20 INPUT A
+30 INPUT B
+40 INPUT C
+50 INPUT D$
+60 PRINT
+70 IF A<>42 THEN 130
+80 IF B<>-7.5 THEN 130
+90 IF C<>1000 THEN 130
+100 IF D$<>"HELLO" THEN 130
+110 PRINT "PASS: INPUT FILE READ"
+120 END
+130 PRINT "FAIL: INPUT FILE VALUES"
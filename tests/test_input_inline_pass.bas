@@ -0,0 +1,12 @@
+10 REM INPUT FROM THE COMMAND LINE, THEN THE DEFAULT KEEP AT ITS END
+20 B=99
+30 INPUT A
+40 INPUT C$
+50 INPUT B
+60 PRINT
+70 IF A<>12 THEN 120
+80 IF C$<>"WORD" THEN 120
+90 IF B<>99 THEN 120
+100 PRINT "PASS: INLINE INPUT READ"
+110 END
+120 PRINT "FAIL: INLINE INPUT VALUES"
@@ -0,0 +1,14 @@
+10 REM STDIN READ AHEAD BY THE READER THREAD, MORE LINES THAN ITS RING HOLDS
+20 S=0
+30 FOR I=1 TO 1500
+40 INPUT X
+50 S=S+X
+60 NEXT I
+70 X=-1
+80 INPUT X
+90 PRINT
+100 IF S<>1125750 THEN 140
+110 IF X<>-1 THEN 140
+120 PRINT "PASS: PREFETCHED INPUT READ"
+130 END
+140 PRINT "FAIL: PREFETCHED INPUT SUM ";S
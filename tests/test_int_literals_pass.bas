@@ -0,0 +1,8 @@
+10 REM SMALL INTEGER LITERALS AT THE ENCODING BOUNDARIES
+20 A=0+255+256+65535
+30 IF A<>66046 PRINT "FAIL: INT SUM ";A : END
+40 B=65536+0.5
+50 IF B*2<>131073 PRINT "FAIL: POOL LITERAL ";B : END
+60 C=-255
+70 IF C+255<>0 PRINT "FAIL: NEGATED LITERAL ";C : END
+80 PRINT "PASS: INTEGER LITERALS"
@@ -0,0 +1,3 @@
+10 REM CO. HASHES TO A KEYWORD'S SLOT BUT IS NO SPELLING OF IT: REJECTED
+20 A=CO.(0)
+30 PRINT "CO. ACCEPTED"
@@ -0,0 +1,33 @@
+10 REM EVERY KEYWORD BY NAME, BY ABBREVIATION AND IN LOWER CASE
+20 IF SIN(30)<>SI.(30) GOTO 300
+25 IF TAN(45)<>ta.(45) GOTO 300
+30 IF ASN(.5)<>AS.(.5) GOTO 300
+35 IF ACS(.5)<>AC.(.5) GOTO 300
+40 IF ATN(1)<>AT.(1) GOTO 300
+45 IF LOG(2)<>LO.(2) GOTO 300
+50 IF EXP(1)<>EX.(1) GOTO 300
+55 IF DMS(2.5)<>DM.(2.5) GOTO 300
+60 IF ABS(-2)<>AB.(-2) GOTO 300
+65 IF SGN(-2)<>SG.(-2) GOTO 300
+70 IF cos(0)+ln(1)+sqr(4)+deg(2)+int(2.5)<>7 GOTO 300
+75 LE. A=1: let B=2: LET C=3
+80 IF A+B+C<>6 T. 300
+85 F. I=1 TO 3 STE. 2: N. I
+90 FOR J=1 to 2 step 1: next J
+95 IF I+J<>8 THEN 300
+100 GOS. 200: gosub 210: GOSUB 220
+105 IF D<>3 GOTO 300
+110 RA.: DEG.: GRAD: degree: RADIAN
+115 CL.
+120 IF A<>0 G. 300
+125 B.: beep: PA. "": pause ""
+130 A. X: aread Y: U. "###": using
+133 I. K: input L: PRINT
+134 IF K+L<>11 GOTO 300
+135 P. "PASS: KEYWORD SPELLINGS"
+140 E.
+200 D=D+1: RE.
+210 D=D+1: return
+220 D=D+1: RETURN
+300 PRINT "FAIL: KEYWORD SPELLINGS"
+310 S.
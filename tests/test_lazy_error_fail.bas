@@ -0,0 +1,4 @@
+10 REM --LAZY: A BAD LINE STOPS THE RUN WHEN IT IS REACHED
+20 PRINT "BEFORE THE BAD LINE"
+30 PRINT @
+40 PRINT "BAD LINE RAN"
@@ -0,0 +1,8 @@
+10 REM A tail call check must not tokenize a line that never runs
+20 GOSUB 100
+30 PRINT "FAIL: RETURNED"
+40 END
+100 GOSUB 200
+110 PRINT @
+200 PRINT "PASS: CALLEE ENDED"
+210 END
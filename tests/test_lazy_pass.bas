@@ -0,0 +1,16 @@
+10 REM --LAZY: LINES TOKENIZED WHEN FIRST REACHED, A BAD LINE NEVER RUN IS NO ERROR
+20 FOR I=1 TO 3
+30 S=S+2.5
+40 GOSUB "TWICE"
+50 NEXT I
+60 N=100
+70 GOTO N+20
+80 PRINT @
+100 PRINT "FAIL: COMPUTED GOTO"
+110 END
+120 IF S<>7.5 GOTO 100
+130 IF T<>6 GOTO 100
+140 PRINT "PASS: LAZY LINES"
+150 END
+200 "TWICE" T=T+2
+210 RETURN
@@ -0,0 +1,4 @@
+10 REM --LAZY --VALIDATE: A BAD LINE FAILS THE LOAD, EVEN ONE THAT NEVER RUNS
+20 PRINT "RUN STARTED"
+30 END
+40 PRINT @
@@ -0,0 +1,115 @@
+10 REM BLANK, DIGIT AND WORD RUNS LONGER THAN A VECTOR, STARTING AT EVERY OFFSET
+15 S=0
+20 S =                                                                      S +  1 
+25  S  =                                                                     S  +   1  
+30   S   =                                                                    S   +    1   
+35    S    =                                                                   S    +     1    
+40     S     =                                                                  S     + 1     
+45      S      =                                                                 S      +  1      
+50       S=                                                                S       +   1       
+55        S =                                                               S        +    1        
+60         S  =                                                              S         +     1         
+65          S   =                                                             S          + 1          
+70           S    =                                                            S           +  1           
+75            S     =                                                           S            +   1            
+80             S      =                                                          S             +    1             
+85              S=                                                         S              +     1              
+90               S =                                                        S               + 1               
+95                S  =                                                       S                +  1                
+100                 S   =                                                      S                 +   1                 
+105                  S    =                                                     S                  +    1                  
+110                   S     =                                                    S                   +     1                   
+115                    S      =                                                   S                    + 1                    
+120                     S=                                                  S                     +  1                     
+125                      S =                                                 S                      +   1                      
+130                       S  =                                                S                       +    1                       
+135                        S   =                                               S                        +     1                        
+140                         S    =                                              S                         + 1                         
+145                          S     =                                             S                          +  1                          
+150                           S      =                                            S                           +   1                           
+155                            S=                                           S                            +    1                            
+160                             S =                                          S                             +     1                             
+165                              S  =                                         S                              + 1                              
+170                               S   =                                        S                               +  1                               
+175                                S    =                                       S                                +   1                                
+180                                 S     =                                      S                                 +    1                                 
+185                                  S      =                                     S                                  +     1                                  
+190                                   S=                                    S                                   + 1                                   
+195                                    S =                                   S                                    +  1                                    
+200                                     S  =                                  S                                     +   1                                     
+205                                      S   =                                 S                                      +    1                                      
+210                                       S    =                                S                                       +     1                                       
+215                                        S     =                               S                                        + 1                                        
+220                                         S      =                              S                                         +  1                                         
+225                                          S=                             S                                          +   1                                          
+230                                           S =                            S                                           +    1                                           
+235                                            S  =                           S                                            +     1                                            
+240                                             S   =                          S                                             + 1                                             
+245                                              S    =                         S                                              +  1                                              
+250                                               S     =                        S                                               +   1                                               
+255                                                S      =                       S                                                +    1                                                
+260                                                 S=                      S                                                 +     1                                                 
+265                                                  S =                     S                                                  + 1                                                  
+270                                                   S  =                    S                                                   +  1                                                   
+275                                                    S   =                   S                                                    +   1                                                    
+280                                                     S    =                  S                                                     +    1                                                     
+285                                                      S     =                 S                                                      +     1                                                      
+290                                                       S      =                S                                                       + 1                                                       
+295                                                        S=               S                                                        +  1                                                        
+300                                                         S =              S                                                         +   1                                                         
+305                                                          S  =             S                                                          +    1                                                          
+310                                                           S   =            S                                                           +     1                                                           
+315                                                            S    =           S                                                            + 1                                                            
+320                                                             S     =          S                                                             +  1                                                             
+325                                                              S      =         S                                                              +   1                                                              
+330                                                               S=        S                                                               +    1                                                               
+335                                                                S =       S                                                                +     1                                                                
+340                                                                 S  =      S                                                                 + 1                                                                 
+345                                                                  S   =     S                                                                  +  1                                                                  
+350                                                                   S    =    S                                                                   +   1                                                                   
+355                                                                    S     =   S                                                                    +    1                                                                    
+360                                                                     S      =  S                                                                     +     1                                                                     
+365                                                                      S= S                                                                      + 1                                                                      
+370 IF S<>70 PRINT "FAIL: BLANK RUNS ";S : END
+375 B=00000000000123              :C=99999999999999
+380 IF B<>123 PRINT "FAIL: DIGIT RUN 14" : END
+385 IF C<1E13 PRINT "FAIL: DIGIT RUN 14" : END
+390 B=000000000000123               :C=999999999999999
+395 IF B<>123 PRINT "FAIL: DIGIT RUN 15" : END
+400 IF C<1E14 PRINT "FAIL: DIGIT RUN 15" : END
+405 B=0000000000000123                :C=9999999999999999
+410 IF B<>123 PRINT "FAIL: DIGIT RUN 16" : END
+415 IF C<1E15 PRINT "FAIL: DIGIT RUN 16" : END
+420 B=00000000000000123                 :C=99999999999999999
+425 IF B<>123 PRINT "FAIL: DIGIT RUN 17" : END
+430 IF C<1E16 PRINT "FAIL: DIGIT RUN 17" : END
+435 B=0000000000000000000000000000123                               :C=9999999999999999999999999999999
+440 IF B<>123 PRINT "FAIL: DIGIT RUN 31" : END
+445 IF C<1E30 PRINT "FAIL: DIGIT RUN 31" : END
+450 B=00000000000000000000000000000123                                :C=99999999999999999999999999999999
+455 IF B<>123 PRINT "FAIL: DIGIT RUN 32" : END
+460 IF C<1E31 PRINT "FAIL: DIGIT RUN 32" : END
+465 B=000000000000000000000000000000123                                 :C=999999999999999999999999999999999
+470 IF B<>123 PRINT "FAIL: DIGIT RUN 33" : END
+475 IF C<1E32 PRINT "FAIL: DIGIT RUN 33" : END
+480 B=0000000000000000000000000000000000000123                                        :C=9999999999999999999999999999999999999999
+485 IF B<>123 PRINT "FAIL: DIGIT RUN 40" : END
+490 IF C<1E39 PRINT "FAIL: DIGIT RUN 40" : END
+495                        IF S>69 LET S=S+1
+500                         IF S>69 LET S=S+1
+505                          IF S>69 LET S=S+1
+510                           IF S>69 LET S=S+1
+515                            IF S>69 LET S=S+1
+520                             IF S>69 LET S=S+1
+525                              IF S>69 LET S=S+1
+530                               IF S>69 LET S=S+1
+535                                IF S>69 LET S=S+1
+540                                 IF S>69 LET S=S+1
+545                                  IF S>69 LET S=S+1
+550                                   IF S>69 LET S=S+1
+555                                    IF S>69 LET S=S+1
+560                                     IF S>69 LET S=S+1
+565                                      IF S>69 LET S=S+1
+570                                       IF S>69 LET S=S+1
+575 IF S<>86 PRINT "FAIL: WORD RUNS ";S : END
+580 PRINT "PASS: LONG SPANS"
@@ -0,0 +1,4 @@
+10 REM A LINE LONGER THAN 512 CHARACTERS IS READ WHOLE
+20 A=1                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                        +2                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                        +3
+30 IF A<>6 PRINT "FAIL: LONG LINE ";A : END
+40 PRINT "PASS: LONG LINE"
\ No newline at end of file
@@ -0,0 +1,7 @@
+40 IF A<>3 PRINT "FAIL: REPLACED LINE ";A : END
+10 REM LINES OUT OF ORDER ARE SORTED, THE LAST COPY OF A LINE WINS
+30 A=A+1
+20 A=1
+30 A=A+2
+50 IF B<>0 PRINT "FAIL: ORDER ";B : END
+60 PRINT "PASS: UNORDERED LINES"
@@ -0,0 +1,7 @@
+10 REM MORE OUTPUT THAN ONE BUFFER, THEN THE MARKER AT THE END
+20 FOR I=1 TO 1500
+30 PRINT "FILLING THE OUTPUT BUFFER, LINE ";I
+40 NEXT I
+50 BEEP
+60 PAUSE "PAUSE FLUSHES"
+70 PRINT "PASS: BUFFERED OUTPUT COMPLETE"
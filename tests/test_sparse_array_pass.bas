@@ -0,0 +1,12 @@
+10 REM A(n) far above the dense cells, in sparse pages (--extended)
+20 A(1000)=1.5
+30 A(1000000)=2.5
+40 A(268435456)=3.5
+50 A$(1000001)="HIGH"
+60 IF A(1000)<>1.5 PRINT "FAIL: A(1000) ";A(1000) : END
+70 IF A(1000000)<>2.5 PRINT "FAIL: A(1000000) ";A(1000000) : END
+80 IF A(268435456)<>3.5 PRINT "FAIL: LAST CELL" : END
+90 IF A$(1000001)<>"HIGH" PRINT "FAIL: STRING CELL" : END
+100 IF A(999999)<>0 PRINT "FAIL: UNSTORED CELL IN A PAGE" : END
+110 IF A(50000000)<>0 PRINT "FAIL: CELL OF A MISSING PAGE" : END
+120 PRINT "PASS: SPARSE CELLS"
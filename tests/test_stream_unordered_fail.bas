@@ -0,0 +1,5 @@
+10 REM Streamed lines must come in increasing order
+20 PRINT "A"
+40 PRINT "B"
+30 PRINT "C"
+50 PRINT "D"
@@ -0,0 +1,11 @@
+10 REM LABELS AND STRING COMPARISONS MATCH WHOLE STRINGS
+20 GOTO "STEP2"
+30 "STEP" PRINT "FAIL: LABEL PREFIX MATCHED" : END
+40 "STEP2" A$="MENU"
+50 IF A$="MENUX" PRINT "FAIL: LONGER STRING EQUAL" : END
+60 IF A$="MEN" PRINT "FAIL: SHORTER STRING EQUAL" : END
+70 B$="menu"
+80 IF A$<>B$ PRINT "FAIL: CASE FOLDING" : END
+90 C$="ABCDEFGXYZ"
+100 IF C$<>"ABCDEFGQQ" PRINT "FAIL: 7 CHAR TRUNCATION" : END
+110 PRINT "PASS: STRING WORDS"
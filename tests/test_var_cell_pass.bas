@@ -0,0 +1,11 @@
+10 REM EACH VARIABLE IS ONE 8-BYTE CELL SHARED BY A-Z AND A(N)
+20 B$="ABCDEFGHIJ"
+30 IF A$(2)<>"ABCDEFG" PRINT "FAIL: 7 CHAR STRING IN SHARED CELL" : END
+40 A(3)=-1E99
+50 IF C<>-1E99 PRINT "FAIL: NEGATIVE NUMBER IN SHARED CELL" : END
+60 D$="X"
+70 D=0.5
+80 IF A(4)<>0.5 PRINT "FAIL: NUMBER OVERWRITES STRING" : END
+90 CLEAR
+100 IF B<>0 PRINT "FAIL: CLEAR" : END
+110 PRINT "PASS: VARIABLE CELLS"
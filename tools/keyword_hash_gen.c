@@ -0,0 +1,154 @@
+/* Keyword perfect hash generator.
+ *
+ * Reads the keyword list (keywords.def) and searches for a seed under which
+ * the hash below sends every full name and abbreviation to its own slot, then
+ * writes keyword_hash.h: the hash function, the seed and the slot table.
+ * Built and run by src/Makefile; the output is committed so that a plain
+ * `cc *.c` build needs no generation step.
+ *
+ * Usage: keyword_hash_gen > keyword_hash.h */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+enum
+{
+    HASH_SIZE = 256,       /* Slots, a power of two (an entry fits a byte) */
+    SEED_TRIES = 1 << 24   /* Give up after this many seeds */
+};
+
+typedef struct
+{
+    const char *name;
+    const char *abbrev;
+} Spellings;
+
+static const Spellings keywords[] = {
+#define KEYWORD(name, abbrev, token) {name, abbrev},
+#include "keywords.def"
+#undef KEYWORD
+};
+
+enum
+{
+    KEYWORDS_LEN = sizeof(keywords) / sizeof(keywords[0])
+};
+
+/* Hash function, written out verbatim into the generated header */
+#define HASH_SOURCE                                                        \
+    "/* FNV-1a over the case-folded word (letters, digits and '.' only:\n" \
+    " * c | 0x20 folds the letters and keeps the rest apart) */\n"         \
+    "static inline uint32_t keyword_hash(const char *word, int len)\n"     \
+    "{\n"                                                                  \
+    "    uint32_t hash = 2166136261u ^ KEYWORD_HASH_SEED;\n"              \
+    "    for (int i = 0; i < len; i++)\n"                                  \
+    "        hash = (hash ^ (uint8_t)(word[i] | 0x20)) * 16777619u;\n"     \
+    "    return (hash ^ (hash >> 16)) & (KEYWORD_HASH_SIZE - 1);\n"        \
+    "}\n"
+
+static uint32_t keyword_hash(uint32_t seed, const char *word, int len)
+{
+    uint32_t hash = 2166136261u ^ seed; /* As in HASH_SOURCE */
+    for (int i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)(word[i] | 0x20)) * 16777619u;
+    return (hash ^ (hash >> 16)) & (HASH_SIZE - 1);
+}
+
+/* Whether two spellings are the same under the hash's case folding */
+static bool same_spelling(const char *a, const char *b)
+{
+    for (; *a != '\0' && *b != '\0'; a++, b++)
+    {
+        if ((*a | 0x20) != (*b | 0x20))
+            return false;
+    }
+    return *a == *b;
+}
+
+/* Slot entry: (keyword index * 2 + 1 for the abbreviation) + 1, 0 empty */
+static uint8_t slots[HASH_SIZE];
+
+/* Place every spelling under seed, false on a collision */
+static bool try_seed(uint32_t seed)
+{
+    memset(slots, 0, sizeof(slots));
+    for (int i = 0; i < KEYWORDS_LEN; i++)
+    {
+        for (int abbrev = 0; abbrev < 2; abbrev++)
+        {
+            const char *spelling = abbrev ? keywords[i].abbrev : keywords[i].name;
+            if (spelling == NULL)
+                continue;
+            uint32_t slot = keyword_hash(seed, spelling, (int)strlen(spelling));
+            if (slots[slot] != 0)
+                return false;
+            slots[slot] = (uint8_t)(i * 2 + abbrev + 1);
+        }
+    }
+    return true;
+}
+
+int main(void)
+{
+    if (KEYWORDS_LEN * 2 + 1 > 255)
+    {
+        fprintf(stderr, "keyword_hash_gen: too many keywords for byte entries\n");
+        return 1;
+    }
+
+    /* Duplicate spellings can never be told apart */
+    int len_max = 0;
+    for (int i = 0; i < KEYWORDS_LEN * 2; i++)
+    {
+        const char *a = i % 2 ? keywords[i / 2].abbrev : keywords[i / 2].name;
+        if (a == NULL)
+            continue;
+        if ((int)strlen(a) > len_max)
+            len_max = (int)strlen(a);
+        for (int j = i + 1; j < KEYWORDS_LEN * 2; j++)
+        {
+            const char *b = j % 2 ? keywords[j / 2].abbrev : keywords[j / 2].name;
+            if (b != NULL && same_spelling(a, b))
+            {
+                fprintf(stderr, "keyword_hash_gen: duplicate spelling %s\n", a);
+                return 1;
+            }
+        }
+    }
+
+    uint32_t seed = 0;
+    while (!try_seed(seed))
+    {
+        if (++seed == SEED_TRIES)
+        {
+            fprintf(stderr, "keyword_hash_gen: no collision-free seed found\n");
+            return 1;
+        }
+    }
+
+    printf("/* Generated by tools/keyword_hash_gen.c from keywords.def - do not edit */\n"
+           "#ifndef KEYWORD_HASH_H\n"
+           "#define KEYWORD_HASH_H\n"
+           "\n"
+           "#include <stdint.h>\n"
+           "\n"
+           "#define KEYWORD_HASH_SEED %uu\n"
+           "\n"
+           "enum\n"
+           "{\n"
+           "    KEYWORD_HASH_SIZE = %d,\n"
+           "    KEYWORD_LEN_MAX = %d /* Longest spelling */\n"
+           "};\n"
+           "\n"
+           HASH_SOURCE
+           "\n"
+           "/* Slot entry: (keyword index * 2 + 1 for the abbreviation) + 1, 0 empty */\n"
+           "static const uint8_t keyword_slots[KEYWORD_HASH_SIZE] = {",
+           seed, HASH_SIZE, len_max);
+    for (int i = 0; i < HASH_SIZE; i++)
+        printf("%s%3d%s", i % 16 == 0 ? "\n    " : " ", slots[i], i + 1 < HASH_SIZE ? "," : "");
+    printf("\n};\n\n#endif /* KEYWORD_HASH_H */\n");
+    return 0;
+}